@@ -1,6 +1,14 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE			// memfd_create(), vmsplice(), F_SETPIPE_SZ, sched_*affinity()
+#endif
+
 #include "matrix_mul.h"
+#include "matrix_mul_options.h"
+#include "matrix_mul_sched.h"
+#include "matrix_mul_threads.h"
 
 #include "errors.h"
+#include "perf_counters.h"
 
 //#define DO_TRACE 1
 #include "trace.h"
@@ -12,7 +20,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 /**
  * The Header file for wait system call
@@ -27,609 +43,2497 @@
  #define FDCONSTANT 2
 
 /**
- * The declaration holds to clanup memory and exit processes on error in method 
+ * Capacity of a worker trace ring, in tiles.  The client drains a ring
+ * whenever it reads a result of its worker, and a worker never has
+ * more than TASK_RING tiles outstanding, so a ring never fills.
  */
- MatrixBaseType cleanUpFlag;
+ #define TRACE_RING 16
 
 /**
- * The Variable holds the declaration of one of the dimensions of file descriptor.
+ * Trace record of one tile computed by a worker: the dot products of
+ * rows [rowBegin, rowEnd) with columns [colBegin, colEnd).
  */
+ typedef struct TraceRecord {
+     int rowBegin;
+     int rowEnd;
+     int colBegin;
+     int colEnd;
+ } TraceRecord;
 
- MatrixBaseType fileDescCols; 
+/**
+ * Single producer, single consumer ring of trace records in memory
+ * shared between a worker, which appends at head, and the client,
+ * which consumes at tail.  Both counters only grow; a record is at
+ * index counter % TRACE_RING.
+ */
+ typedef struct TraceRing {
+     unsigned head;
+     unsigned tail;
+     TraceRecord records[TRACE_RING];
+ } TraceRing;
 
 /**
- * The Variable holds the declaration of errno macro
+ * I/O accounting of one process of the pool: system calls on the pipes
+ * (including poll()) and bytes written to and read from them.  Every
+ * process only updates its own counters; they are read by
+ * getMatrixMulStats().
  */
- extern MatrixBaseType errno;
+ typedef struct IoCounters {
+     unsigned long long syscalls;
+     unsigned long long bytesOut;
+     unsigned long long bytesIn;
+ } IoCounters;
 
 /**
  * The Struct contains information about number of Worker processes,
- * Worker processes pool, pipes for inter-process communication between client 
- * and workers, trace enabled/disabled flag.	
+ * Worker processes pool, pipes for inter-process communication between client
+ * and workers, trace enabled/disabled flag.
  */
 
  struct MatrixMul {
-	
+
      /*
       *	Total number of workers - Slave processes
-      */ 
-     MatrixBaseType noOfWorkers;
-	
+      */
+     int noOfWorkers;
+
      /*
       * Check enable/disable trace flag
       */
-     _Bool traceFlag;		
+     _Bool traceFlag;
+
+     /*
+      * Trace output given to newMatrixMul()
+      */
+     FILE *trace;
+
+     /*
+      * When tracing, one trace ring per worker, mapped shared before
+      * the workers are forked.  Instead of printing every dot product,
+      * a worker appends one binary record per tile it has computed; the
+      * client drains the rings as results arrive, noting which worker
+      * computed each (row, panel) of the product in traceOwners, and
+      * formats all trace lines in bulk, in row-major order, into trace
+      * once the product is complete.
+      */
+     TraceRing *traceRings;
+     int *traceOwners;
+     size_t traceOwnersCapacity;
+
+     /*
+      * I/O counters of the client (index 0) and of worker i (index
+      * 1 + i), mapped shared before the workers are forked
+      */
+     IoCounters *ioCounters;
+
+     /*
+      * MATRIX_MUL_* flags given at construction
+      */
+     unsigned flags;
+
+     /*
+      * With MATRIX_MUL_THREADS, the thread pool doing all the work; the
+      * process pool below (workers, pipes, shared region) is then
+      * never set up
+      */
+     MatrixMulThreads *threads;
+
+     /*
+      * Shared data region, used with MATRIX_MUL_SHARED_DATA.  It is a
+      * memfd mapped MAP_SHARED before the workers are forked, so they
+      * inherit both the descriptor and the mapping.  It holds a, b and
+      * c of the current multiplication back to back; the client grows
+      * it when needed and a worker remaps its view when a task refers
+      * to a larger region than it has mapped.
+      */
+     int sharedFd;
+     MatrixBaseType *shared;
+     size_t sharedBytes;
+
+     /*
+      * Splice large payloads into the pipes with vmsplice(), used with
+      * MATRIX_MUL_ZERO_COPY when the kernel supports it.  Cleared if
+      * vmsplice() later turns out not to work, falling back to copies.
+      */
+     _Bool zeroCopy;
+
+     /*
+      * Panels of the multiplier made contiguous for MATRIX_MUL_TILES,
+      * reused across multiplications
+      */
+     MatrixBaseType *packedB;
+     size_t packedCapacity;
+
+     /*
+      * Dispatcher state kept across multiplications: the traffic with
+      * each worker, as a straggler may still owe results of an earlier
+      * call, the chunks of the current call, and the number of the
+      * current call, which tags its tasks
+      */
+     struct WorkerIo *io;
+     struct Chunk *chunks;
+     size_t chunksCapacity;
+     unsigned generation;
+
+     /*
+      * Hardware performance counters around each mulMatrixMul() call.
+      * Enabled by setting MATRIX_MUL_PERF in the environment; counters
+      * which are unavailable on the host are reported as n/a.
+      * Index 0 counts the client, index 1 + i counts worker i.
+      */
+     _Bool perfFlag;
+     PerfCounters *perfCounters;
 
      /*
-      * This pipe associated with sending matrix multiplicand and 
+      * This pipe associated with sending matrix multiplicand and
       * matrix multiplier data to worker processes.
-      * Pipe Function performs :	
-      * 1. It reads rows and columns elements from two matrices and sends that data to
-      *    to worker processes which is selected on round-robin fashion.
-      * 2. Read dot product from the worker process and then store it into the final matrix.		
-      */				
-     MatrixBaseType **fileDescParentToWorkers;	
+      * The client only keeps the write end [1]; worker i only keeps
+      * the read end [0] of its own pipe.
+      */
+     int **fileDescParentToWorkers;
+
+     /*
+      * This pipe associated with sending the dot products computed by
+      * a worker back to the client.
+      * The client only keeps the read end [0]; worker i only keeps the
+      * write end [1] of its own pipe.
+      */
+     int **fileDescWorkersToParent;
+
+     /*
+      * Ready channel shared by all workers.  A worker which has
+      * finished a task writes its index here before sending the result,
+      * asking for another chunk; the index is smaller than PIPE_BUF so
+      * the writes of different workers never interleave.
+      * The client only keeps the read end [0]; the workers only keep
+      * the write end [1].
+      */
+     int readyPipe[FDCONSTANT];
+
+     /*
+      * With MATRIX_MUL_PIN_PARENT, the affinity of the client before it
+      * was pinned, restored by freeMatrixMul()
+      */
+     _Bool parentPinned;
+     cpu_set_t parentAffinity;
+
+     /*
+      * No call has failed, so the workers are in step with the client
+      * and the multiplier may be parked in the warm pool
+      */
+     _Bool reusable;
 
      /*
-      * This pipe associated with performing matrix multiplication i.e dot product
-      * with data received from client process
-      * Function it performs :
-      * 1. Reads input data that was sent by the client
-      * 2. Performs dot product
-      * 3. Send the result back to the client process		
-      */	  	
-     MatrixBaseType **fileDescWorkersToParent;			
+      * With MATRIX_MUL_WARM_POOL, how long the multiplier may stay
+      * parked, since when it has been, and the next parked one
+      */
+     unsigned idleMs;
+     struct timespec idleSince;
+     struct MatrixMul *nextIdle;
 
      /*
       * Worker processes pool - Each Unique Process Id - Child processes
-      */	
-     pid_t *workers;			
+      * A worker stays alive, looping on its pipe, until freeMatrixMul()
+      * closes the pipe.
+      */
+     pid_t *workers;
 
  };
 
 /**
- * Matrix Multiplier Variable Declaration
+ * Chunks queued at a worker, including the one it is computing, so it
+ * never waits for the client between chunks.  A worker may announce
+ * itself ready, and so be given one more chunk, before the client has
+ * read the result it announced; hence the extra slot in the ring.
  */
-struct MatrixMul *matrixMul;
+ #define TASK_DEPTH 2
+ #define TASK_RING (TASK_DEPTH + 1)
+ _Static_assert(TRACE_RING >= TASK_RING, "a trace ring must hold every outstanding tile");
 
+/**
+ * With MATRIX_MUL_ZERO_COPY, payloads of at least ZEROCOPY_MIN_BYTES
+ * are spliced rather than copied into the pipes, whose capacity is
+ * raised towards ZEROCOPY_PIPE_BYTES so a whole chunk fits in flight.
+ */
+ #define ZEROCOPY_MIN_BYTES (16 * 1024)
+ #define ZEROCOPY_PIPE_BYTES (1024 * 1024)
 
-/** Return a multi-process matrix multiplier with nWorkers worker
- *  processes.  Set *err to an appropriate error number (documented in
- *  errno(3)) on error.
- *
- *  If trace is not NULL, turn on tracing for calls to mulMatrixMul()
- *  using returned MatrixMul.  Specifically, each dot-product
- *  computation must be logged to trace as a line in the form:
- *
- *  INDEX[PID]: [I]x[J] = Z
- *
- *  where INDEX in [0, nWorkers) is the index of the worker and PID is
- *  its pid, I is the index of the row in the multiplicand, J is the
- *  index of the row in the multiplier and Z is their dot-product
- *  computed by child process PID.  The spacing must be exactly as
- *  shown above and all values must be output in decimal with no
- *  leading zeros or redundant + signs.
- *
+/**
+ * Initial size of the shared data region
  */
-MatrixMul *
-newMatrixMul(int nWorkers, FILE *trace, int *err)
-{
+ #define SHARED_INITIAL_BYTES (1024 * 1024)
 
-	/**
-	 * File descriptor 0 for reading and 1 for writing
-	 * This is the second dimension of each worker process file descriptor
- 	 * Total number of pipes = total number of worker processes 
-	 */
-	fileDescCols = FDCONSTANT;				
+/**
+ * Default time a multiplier freed with MATRIX_MUL_WARM_POOL stays
+ * parked, workers running, before they are stopped
+ */
+ #define WARM_IDLE_MS 5000
 
-	/**
-	 * Memory allocation
-	 */
- 	matrixMul = malloc(sizeof(struct MatrixMul));
-	if(matrixMul == NULL)
-	{
-		*err = errno;		     // set error no
-		fatal("Malloc Error : \n");  // set error msg
-		return NULL;
-	}
+/**
+ * Types of the messages exchanged over the pipes
+ */
+ typedef enum {
+	MSG_MATRIX_B = 1,	// client to worker: columns [colBegin, colEnd) of the multiplier b[n2][n3]
+	MSG_ROWS,		// client to worker: rows [rowBegin, rowEnd) of a[][n2]
+	MSG_RESULT,		// worker to client: tile [rowBegin, rowEnd) x [colBegin, colEnd) of c[][n3]
+	MSG_SHARED_ROWS,	// client to worker: compute that tile in the shared region
+	MSG_SHARED_DONE		// worker to client: that tile of c is ready in the shared region
+ } MessageType;
 
-	matrixMul -> noOfWorkers = nWorkers;	// number of worker processes
-	
-	/**
-	 * This is used to check whether trace is null or not.
-         * And set the traceflag accordingly for tracing the output of dot product 
-	 */
-	if(trace != NULL)
+/**
+ * Header of every message.  It is followed on the pipe by the
+ * contiguous rows described by the header, and is written together
+ * with them in a single writev().
+ */
+ typedef struct MessageHeader {
+
+     int type;		// MessageType
+     int rowBegin;	// first row carried, for MSG_ROWS and MSG_RESULT
+     int rowEnd;	// one past last row carried
+     int colBegin;	// first column of the multiplier and product carried
+     int colEnd;	// one past last column carried
+     int n1;		// rows of the multiplicand, for MSG_SHARED_ROWS
+     int n2;		// shared dimension
+     int n3;		// columns of the multiplier and product
+     size_t sharedBytes;	// size of the shared region, for MSG_SHARED_ROWS
+     unsigned generation;	// call which sent the task, echoed in the result
+
+ } MessageHeader;
+
+/**
+ * A chunk of rows of a panel handed to a worker: the rows
+ * [rowBegin, rowEnd) and columns [colBegin, colEnd) of the product
+ * assigned by the call numbered generation, as chunk number chunk of
+ * that call.
+ */
+typedef struct Task {
+     unsigned generation;
+     int chunk;
+     int rowBegin;
+     int rowEnd;
+     int colBegin;
+     int colEnd;
+} Task;
+
+/**
+ * Client side state of the traffic with one worker.  Messages are
+ * written and read incrementally on nonblocking descriptors, so the
+ * client never blocks on one pipe while another worker waits for it.
+ * The state outlives a call: with MATRIX_MUL_SPECULATE a call may
+ * return while a straggler still owes results, which later calls read
+ * and discard.
+ */
+typedef struct WorkerIo {
+
+     /*
+      * Tasks of the worker whose results are still due, oldest first:
+      * ring entries [head, head + count).  The messages of the first
+      * nSent of them have been started.
+      */
+     Task tasks[TASK_RING];
+     int head;
+     int count;
+     int nSent;
+
+     /*
+      * Ready announcements not yet answered with a chunk because the
+      * ring was full
+      */
+     int wanted;
+
+     /*
+      * The multiplier still has to be sent (pipe mode only)
+      */
+     _Bool sendB;
+
+     /*
+      * Message being written: its header, and the unwritten parts of
+      * header and payload in out[2 - outCount .. 1]
+      */
+     MessageHeader outHeader;
+     struct iovec out[2];
+     int outCount;
+     _Bool outSplice;		// payload goes with vmsplice()
+
+     /*
+      * Message being read: its header, the size of its payload, the
+      * number of bytes of header and payload read so far, and whether
+      * the payload is to be discarded because it is stale or another
+      * worker delivered the same chunk first
+      */
+     MessageHeader inHeader;
+     size_t inPayload;
+     size_t inDone;
+     _Bool inDiscard;
+
+} WorkerIo;
+
+/**
+ * A chunk of rows of one panel of the current call
+ */
+typedef struct Chunk {
+     int rowBegin;
+     int rowEnd;
+     int worker;		// worker it was first assigned to
+     _Bool speculated;		// also assigned to another worker
+     _Bool claimed;		// a result has been accepted, later ones are discarded
+} Chunk;
+
+
+/**
+ * I/O counters of this worker process, NULL in the client
+ */
+static IoCounters *workerCounters;
+
+/**
+ * Count a system call on a pipe of the pool in *counters, if not NULL,
+ * which wrote (written) or read n bytes; n <= 0 moved none.  The
+ * stores are atomic as the client reads the counters of the workers
+ * concurrently.
+ */
+static void
+countIo(IoCounters *counters, ssize_t n, _Bool written)
+{
+	if(counters == NULL)
 	{
-		matrixMul -> traceFlag = true;	// enable log for the output
+		return;
 	}
-	else
+	__atomic_store_n(&counters -> syscalls, counters -> syscalls + 1, __ATOMIC_RELAXED);
+	unsigned long long *bytes = written ? &counters -> bytesOut : &counters -> bytesIn;
+	if(n > 0)
 	{
-		matrixMul -> traceFlag = false;	// disable the log for the output
+		__atomic_store_n(bytes, *bytes + n, __ATOMIC_RELAXED);
 	}
+}
 
-	matrixMul -> workers = malloc(sizeof(MatrixBaseType) * nWorkers);
-	
-	if(matrixMul -> workers == NULL)
+/**
+ * Read exactly size bytes from fd, restarting after signals and short
+ * reads.  Return size on success, 0 on end of file before any data
+ * and -1 with errno set on error (EPIPE for end of file part way).
+ */
+static ssize_t
+readFully(int fd, void *buf, size_t size)
+{
+	size_t done = 0;
+	while(done < size)
 	{
-		*err = errno;			// set error no
-		free(matrixMul);		// free memory
-		fatal("Malloc Error : \n");	// set error msg
-		return NULL;
+		ssize_t n = read(fd, (char *) buf + done, size - done);
+		countIo(workerCounters, n, false);
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		if(n == 0)
+		{
+			if(done == 0) return 0;
+			errno = EPIPE;				// truncated message
+			return -1;
+		}
+		done += n;
 	}
+	return size;
+}
 
-	/**
-	 * Setting up file descriptor for inter-process communication
-         * Pipe per each worker process 
-	 * This is used for client to worker process communication
-         */
-	matrixMul -> fileDescParentToWorkers = malloc(sizeof(MatrixBaseType *) * nWorkers);
-	if(matrixMul -> fileDescParentToWorkers == NULL)
+/**
+ * Write all iovcnt buffers of iov to fd with as few writev() calls as
+ * the pipe allows, restarting after signals and short writes.  iov is
+ * modified.  Return 0 on success, -1 with errno set on error.
+ */
+static int
+writevFully(int fd, struct iovec *iov, int iovcnt)
+{
+	while(iovcnt > 0)
 	{
-		*err = errno;			// set error no
-		free(matrixMul -> workers);	
-		free(matrixMul);
-		fatal("Malloc Error : \n");     // set error msg
-		return NULL;
-	}
+		ssize_t n = writev(fd, iov, iovcnt);
+		countIo(workerCounters, n, true);
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
 
-	/**
- 	 * Specifies two indexes for each row associated process
-	 * File descriptor - 0 for reading and 1 for writing  
-	 * Dynamic allocation
-	 */
-	for(int counter = 0; counter < nWorkers; counter++)
-	{
-		matrixMul -> fileDescParentToWorkers[counter] = malloc(sizeof(MatrixBaseType) * fileDescCols);
+		/**
+		 * Skip the buffers which were written completely and
+		 * advance into the one written partially
+		 */
+		while(iovcnt > 0 && (size_t) n >= iov -> iov_len)
+		{
+			n -= iov -> iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if(iovcnt > 0)
+		{
+			iov -> iov_base = (char *) iov -> iov_base + n;
+			iov -> iov_len -= n;
+		}
 	}
-
-
-	/**
-         * Setting up file descriptor for inter-process communication
-         * Pipe per each worker process 
-         * This is used for workers to client process communication
-         */
-	matrixMul -> fileDescWorkersToParent = malloc(sizeof(MatrixBaseType *) * nWorkers);
-        if(matrixMul -> fileDescWorkersToParent == NULL)
-        {
-                *err = errno;		// set error no
-                free(matrixMul -> workers);
-                free(matrixMul);
-                fatal("Malloc Error : \n");	// set error msg
-                return NULL;
-        }
-
-	/**
-         * Specifies two indexes for each row associated process
-         * File descriptor - 0 for reading and 1 for writing  
-         * Dynamic allocation
-         */
-	for(int counter = 0; counter < nWorkers; counter++)
-        {
-                matrixMul -> fileDescWorkersToParent[counter] = malloc(sizeof(MatrixBaseType) * fileDescCols);
-        }
-
-		
-	/**
-	 * Creating worker process pool.
-         * Creating pipes for parent - children process and children - parent communication 
-         * Setting up error codes 
-         */	
-	for(int worker_counter = 0; worker_counter < nWorkers; worker_counter++)
-        {
-		  /**
-		   * creating pipes pair		
-		   */
-                  if(pipe(matrixMul -> fileDescParentToWorkers[worker_counter]) < 0 || pipe(matrixMul -> fileDescWorkersToParent[worker_counter]) < 0)
-                  {
-			cleanUpFlag = 1;
-                        *err = errno;
-			fatal("Cannot create pipe : \n");
-                        exit(EXIT_FAILURE);
-                  }
-
-		  /**
-		   * fork error checking
-		   */	
-                  if((matrixMul -> workers[worker_counter] = fork()) == -1)
-                  {
-			cleanUpFlag = 1;
-                        *err = errno;
-			fatal("Cannot create worker process : %d \n", worker_counter);   
-                   	exit(EXIT_FAILURE);
-                  }
-
-		  /**
-		   * worker process
-		   */
-                  else if(matrixMul -> workers[worker_counter] == 0)
-                  {
-			if(close(matrixMul -> fileDescWorkersToParent[worker_counter][0]) < 0)
-			{
-				cleanUpFlag = 1;
-				*err = errno;
-				fatal("Child : %d, pid :%ld, close(fd[%d][0]) \n", worker_counter, (long) getpid(), worker_counter);
-			}
-			if(close(matrixMul -> fileDescParentToWorkers[worker_counter][0]) < 0)
-			{
-				cleanUpFlag = 1;
-                                *err = errno;
-                                fatal("Child : %d, pid :%ld, close(fd[%d][0]) \n", worker_counter, (long) getpid(), worker_counter);
-			}
-
-                        matrixMul -> workers[worker_counter] = getpid();
-                        exit(EXIT_SUCCESS);
-                  }
- 		  
- 		  else
-		  {
-			/**
-			 * This check stands to create process fan and not process chain.
-			 * Either you use wait in the parent process like shown below.
-			 * The alternative is to use break inside the child.I prefer this one. 
-			 */
-			wait(NULL);
-		  } 
-        }
-	
-					
-	return matrixMul;	 		// return matrix multiplier structure to be used further 
+	return 0;
 }
 
-/** Free all resources used by matMul.  Specifically, free all memory
- *  and return only after all child processes have been set up to
- *  exit.  Set *err appropriately (as documented in errno(3)) on error.
+/**
+ * Send a message header followed by size bytes of data to fd.
  */
-void
-freeMatrixMul(MatrixMul *matMul, int *err)
+static int
+sendMessage(int fd, const MessageHeader *header, const void *data, size_t size)
 {
+	struct iovec iov[2] = {
+		{ .iov_base = (void *) header, .iov_len = sizeof(*header) },
+		{ .iov_base = (void *) data, .iov_len = size },
+	};
+	return writevFully(fd, iov, (size > 0) ? 2 : 1);
+}
 
-	int status;
-	/**
-         * Wait for all child processes to finish and exit if an error occurs
-	 * This only finishes the child process when an error occurs. 
-         */
-	if(cleanUpFlag == 1)
+/**
+ * Send a message like sendMessage(), but if *zeroCopy is set splice a
+ * payload of at least ZEROCOPY_MIN_BYTES into the pipe with vmsplice()
+ * instead of copying it.  The pipe then refers to the pages of data
+ * until the reader has consumed them, so data must not be modified
+ * before then.  If vmsplice() is not supported, clear *zeroCopy and
+ * copy the payload.
+ */
+static int
+spliceMessage(int fd, const MessageHeader *header, const void *data, size_t size, _Bool *zeroCopy)
+{
+	if(!*zeroCopy || size < ZEROCOPY_MIN_BYTES)
 	{
-        	for(int waitCounter = 0; waitCounter < matMul -> noOfWorkers; waitCounter++)
-        	{
-                	waitpid(matMul-> workers[waitCounter], &status, 0);
-        	}
-		cleanUpFlag = 0;
+		return sendMessage(fd, header, data, size);
+	}
+	if(sendMessage(fd, header, NULL, 0) < 0)
+	{
+		return -1;
 	}
 
-
-	/**
-	 * Free all the memory used by Matrix Multiplier resources
-	 */
-
-	if(matMul != NULL)
+	struct iovec iov = { .iov_base = (void *) data, .iov_len = size };
+	while(iov.iov_len > 0)
 	{
-		free(matMul -> workers);
-		for(int counter = 0; counter < matMul -> noOfWorkers; counter++)
+		ssize_t n = vmsplice(fd, &iov, 1, 0);
+		countIo(workerCounters, n, true);
+		if(n < 0)
 		{
-			free(matMul -> fileDescParentToWorkers[counter]);
+			if(errno == EINTR) continue;
+			if(errno != ENOSYS && errno != EINVAL) return -1;
+			*zeroCopy = false;
+			return writevFully(fd, &iov, 1);
 		}
-		free(matMul -> fileDescParentToWorkers);
+		iov.iov_base = (char *) iov.iov_base + n;
+		iov.iov_len -= n;
+	}
+	return 0;
+}
+
+/**
+ * Return true if vmsplice() works on pipes on this host.
+ */
+static _Bool
+canVmsplice(void)
+{
+	int fds[FDCONSTANT];
+	if(pipe(fds) < 0)
+	{
+		return false;
+	}
+	char probe = 0;
+	struct iovec iov = { .iov_base = &probe, .iov_len = sizeof(probe) };
+	_Bool ok = (vmsplice(fds[1], &iov, 1, SPLICE_F_NONBLOCK) == sizeof(probe));
+	close(fds[0]);
+	close(fds[1]);
+	return ok;
+}
 
-		for(int counter = 0; counter < matMul -> noOfWorkers; counter++)
+/**
+ * Raise the capacity of the pipe of fd towards ZEROCOPY_PIPE_BYTES,
+ * halving the request while it exceeds what the system allows
+ * (/proc/sys/fs/pipe-max-size for unprivileged processes).  The
+ * default capacity is kept if even that fails.
+ */
+static void
+enlargePipe(int fd)
+{
+	for(int size = ZEROCOPY_PIPE_BYTES; size > 64 * 1024; size /= 2)
+	{
+		if(fcntl(fd, F_SETPIPE_SZ, size) >= 0)
 		{
-			free(matMul -> fileDescWorkersToParent[counter]);	
+			return;
 		}
-		free(matMul -> fileDescWorkersToParent);
-		free(matMul);
 	}
-	else
+}
+
+/**
+ * Make sure *buf can hold count elements, growing it if needed.
+ * Return false if memory is exhausted.
+ */
+static _Bool
+reserve(MatrixBaseType **buf, size_t *capacity, size_t count)
+{
+	if(count <= *capacity)
+	{
+		return true;
+	}
+	MatrixBaseType *p = realloc(*buf, count * sizeof(MatrixBaseType));
+	if(p == NULL)
 	{
-		 *err = errno;
-		 fatal("Cannot free the allocated memory : \n");
+		return false;
 	}
+	*buf = p;
+	*capacity = count;
+	return true;
+}
 
+/**
+ * Append the record of the tile described by header, just computed by
+ * worker index, to its trace ring.
+ */
+static void
+logTile(TraceRing *ring, const MessageHeader *header, int index)
+{
+	unsigned head = ring -> head;
+	if(head - __atomic_load_n(&ring -> tail, __ATOMIC_ACQUIRE) >= TRACE_RING)
+	{
+		error("worker %d: trace ring overflow", index);
+		_exit(EXIT_FAILURE);
+	}
+	ring -> records[head % TRACE_RING] = (TraceRecord) {
+		.rowBegin = header -> rowBegin, .rowEnd = header -> rowEnd,
+		.colBegin = header -> colBegin, .colEnd = header -> colEnd,
+	};
+	__atomic_store_n(&ring -> head, head + 1, __ATOMIC_RELEASE);
 }
 
-/** Set matrix c[n1][n3] to a[n1][n2] * b[n2][n3].  It is assumed that
- *  the caller has allocated c[][] appropriately.  Set *err to an
- *  appropriate error number (documented in errno(3)) on error.  If
- *  *err is returned as non-zero, then the matMul object may no longer
- *  be valid and future calls to mulMatrixMul() may have unpredictable
- *  behavior.  It is the responsibility of the caller to call
- *  freeMatrixMul() after an error.
- *
- *  All dot-products of rows from a[][] and columns from b[][] must be
- *  performed using the worker processes which were already created in
- *  newMatrixMul() and all IPC must be handled using anonymous pipes.
- *  The multiplication should be set up in such a way so as to allow
- *  the worker processes to work on different dot-products
- *  concurrently.
+/**
+ * Make the worker view *shared of the shared region cover at least
+ * bytes, remapping it from fd if the client has grown the region.
+ * Return false with errno set on failure.
  */
-void
-mulMatrixMul(const MatrixMul *matMul, int n1, int n2, int n3,
-             CONST MatrixBaseType a[n1][n2],
-             CONST MatrixBaseType b[n2][n3],
-             MatrixBaseType c[n1][n3], int *err)
+static _Bool
+mapShared(int fd, MatrixBaseType **shared, size_t *mapped, size_t bytes)
 {
-	
-	/**
-	 * Matrix Multiplication variable declarations
-	 */
-        MatrixBaseType firstCounter, secondCounter, thirdCounter;
+	if(bytes <= *mapped)
+	{
+		return true;
+	}
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED)
+	{
+		return false;
+	}
+	if(*shared != NULL)
+	{
+		munmap(*shared, *mapped);
+	}
+	*shared = p;
+	*mapped = bytes;
+	return true;
+}
 
-	/**
-	 * Multiplicand element
-	 */
-	MatrixBaseType multiplicandElement;
-	
-	/**
-	 * Multiplier element
-	 */
-	MatrixBaseType multiplierElement;
-
-	/**
-  	 * Worker process status flag variable declaration
-	 */
-	MatrixBaseType status;
+/**
+ * Tell the client through the ready channel that worker index is about
+ * to send a result and wants another chunk.
+ */
+static void
+announceReady(int readyFd, int index)
+{
+	ssize_t n;
+	while((n = write(readyFd, &index, sizeof(index))) < 0)
+	{
+		countIo(workerCounters, n, true);
+		if(errno != EINTR)
+		{
+			error("worker %d: cannot write ready channel:", index);
+			_exit(EXIT_FAILURE);
+		}
+	}
+	countIo(workerCounters, n, true);
+}
 
-	/**
-	 * Counter to check number of processes to wait for variable declaration
-	 */
-        MatrixBaseType waitCounter;
-	
-	/**
-	 * Worker process selection variable declaration
-	 * While sending the data, it should get dispersed to multiple worker processes concurrently
-	 * Using round-robin fashion to distribute data to processes
- 	 * This variable holds the typical worker process id.  
-	 */
-        MatrixBaseType workerProcessPoolIdSelection = 0;
+/**
+ * Fill cpus with the CPUs this process may run on, in increasing
+ * order, and return their number; set *allowed to the same set.
+ * Return 0 if the affinity cannot be read.
+ */
+static int
+allowedCpus(cpu_set_t *allowed, int cpus[CPU_SETSIZE])
+{
+	if(sched_getaffinity(0, sizeof(*allowed), allowed) < 0)
+	{
+		return 0;
+	}
+	int nCpus = 0;
+	for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if(CPU_ISSET(cpu, allowed))
+		{
+			cpus[nCpus++] = cpu;
+		}
+	}
+	return nCpus;
+}
 
+/**
+ * In a newly forked worker, close every descriptor inherited from the
+ * client except standard input, output and error and the nKeep of keep.
+ * Besides the pipes of the workers forked before it, a worker inherits
+ * those of every other multiplier of the client, including the ones
+ * parked in the warm pool; it must not hold their write ends open, or
+ * their workers would never see end of file.
+ */
+static void
+closeInheritedFds(const int *keep, int nKeep)
+{
+	DIR *dir = opendir("/proc/self/fd");
+	if(dir == NULL)
+	{
+		return;
+	}
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL)
+	{
+		if(!isdigit((unsigned char) entry -> d_name[0]))
+		{
+			continue;
+		}
+		int fd = atoi(entry -> d_name);
+		_Bool kept = (fd <= STDERR_FILENO || fd == dirfd(dir));
+		for(int i = 0; i < nKeep && !kept; i++)
+		{
+			kept = (fd == keep[i]);
+		}
+		if(!kept)
+		{
+			close(fd);
+		}
+	}
+	closedir(dir);
+}
 
-	/**
-	 * Matrix Multiplication Mechanism 
-	 * Selects Worker process ID from worker process pool in round-robin fashion
-	 * Sends matrix data to workers 
-	 * Reports error codes
-	 * All client- worker communication is using anonymous pipes 
-	 * Send all the matrix data to worker processes
-	 */
-	for(firstCounter = 0; firstCounter < n1; firstCounter++)
-        {
-			/**
-			 * Select worker process id from the pool
-			 */
-			workerProcessPoolIdSelection = (workerProcessPoolIdSelection + 1) % matMul -> noOfWorkers;
-
-                        for(secondCounter = 0; secondCounter < n3; secondCounter++)
-                        {
-
-                                for(thirdCounter = 0; thirdCounter < n2; thirdCounter++)
-                                {
-
-				   multiplicandElement = a[firstCounter][thirdCounter];
-				   multiplierElement   = b[thirdCounter][secondCounter];
-
-				   /*
-				    * Matrix Element
-				    */	
-				   if(write(matMul -> fileDescParentToWorkers[workerProcessPoolIdSelection][1], &multiplicandElement, sizeof(multiplicandElement)) == -1 ) 
-				   {
-    					    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Error writing to pipe : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-
-                                   }
-
-				   /**
-				    * Matrix Element
-				    */	
-                                   if (write(matMul -> fileDescParentToWorkers[workerProcessPoolIdSelection][1], &multiplierElement, sizeof(multiplierElement)) == -1 ) 
-				   {
-					    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Error writing to pipe : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-
-                                   }
-		
-                                }
-                      }
-        }
+/**
+ * Restrict the calling process to cpu.
+ */
+static int
+pinToCpu(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set);
+}
 
+/**
+ * Worker process main loop.  Keep the panel of the multiplier sent with
+ * MSG_MATRIX_B and, for each MSG_ROWS task, compute the corresponding
+ * tile of the product, optionally log every dot product, announce itself on the
+ * ready channel and send the rows back in a single MSG_RESULT.  The
+ * ready announcement goes first so the client never waits on one
+ * worker's result pipe while another is blocked writing a large
+ * result.  The loop ends when the client closes the task pipe in
+ * freeMatrixMul().  Never returns.
+ */
+static void
+runWorker(const struct MatrixMul *matMul, int index)
+{
+	int taskFd = matMul -> fileDescParentToWorkers[index][0];
+	int resultFd = matMul -> fileDescWorkersToParent[index][1];
+	int readyFd = matMul -> readyPipe[1];
+	TraceRing *traceRing = matMul -> traceFlag ? &matMul -> traceRings[index] : NULL;
+	workerCounters = &matMul -> ioCounters[1 + index];
 
 	/**
-	 * Multiplicand Element
-	 */
-	MatrixBaseType multiplicandElementR;
-	
-	/**
-	 * Multiplier Element
+	 * Buffers reused across tasks and multiplications
 	 */
-	MatrixBaseType multiplierElementR;
+	MatrixBaseType *b = NULL, *rows = NULL;
+	size_t bCapacity = 0, rowsCapacity = 0;
+	int n2 = 0, nCols = 0;
 
 	/**
-  	 * Retrieve selected process id from the worker processes pool
+	 * Product buffers.  A spliced result stays referenced by the pipe
+	 * until the client has read it; the client has at most TASK_RING
+	 * chunks outstanding here, so by the time a buffer comes round
+	 * again the result it held has been consumed.
 	 */
-	MatrixBaseType workerProcessPoolIdDisplay = 0;
+	MatrixBaseType *products[TASK_RING] = { NULL };
+	size_t productCapacities[TASK_RING] = { 0 };
+	int nextProduct = 0;
+	_Bool zeroCopy = matMul -> zeroCopy;
 
 	/**
-	 * Holds the results of the dot product of matrix performed by the different worker process
+	 * View of the shared region inherited from the client
 	 */
-	MatrixBaseType sum = 0;
+	MatrixBaseType *shared = matMul -> shared;
+	size_t sharedMapped = matMul -> sharedBytes;
 
-	
-	/**
-	 * Worker processes from the pool used to perform the matrix multiplication
-	 * Dot product calculation and log the output
-	 * Closing unused file descriptor
-	 * Reading dispersed matrix data from the parent 
-	 * Send the dot-product result to client
-	 */
-	for(firstCounter = 0; firstCounter < n1; firstCounter++)
-        {		
+	while(1)
+	{
+		MessageHeader header;
+		ssize_t numRead = readFully(taskFd, &header, sizeof(header));
+		if(numRead == 0)
+		{
+			_exit(EXIT_SUCCESS);			// client is done with us
+		}
+		if(numRead < 0)
+		{
+			error("worker %d: cannot read task:", index);
+			_exit(EXIT_FAILURE);
+		}
+
+		if(header.type == MSG_MATRIX_B)
+		{
+			n2 = header.n2;
+			nCols = header.colEnd - header.colBegin;
+			size_t count = (size_t) n2 * nCols;
+			if(!reserve(&b, &bCapacity, count))
+			{
+				error("worker %d: out of memory", index);
+				_exit(EXIT_FAILURE);
+			}
+			if(count > 0 && readFully(taskFd, b, count * sizeof(MatrixBaseType)) <= 0)
+			{
+				error("worker %d: cannot read multiplier:", index);
+				_exit(EXIT_FAILURE);
+			}
+			continue;
+		}
+
+		int nRows = header.rowEnd - header.rowBegin;
+		if(header.type == MSG_SHARED_ROWS)
+		{
 			/**
-			 * Worker process selection id
+			 * Operands and product live in the shared region: only
+			 * the completion goes back over the pipe
 			 */
-			workerProcessPoolIdDisplay = (workerProcessPoolIdDisplay + 1) % matMul -> noOfWorkers;
+			if(!mapShared(matMul -> sharedFd, &shared, &sharedMapped, header.sharedBytes))
+			{
+				error("worker %d: cannot map shared region:", index);
+				_exit(EXIT_FAILURE);
+			}
+			size_t lda = header.n2, ldb = header.n3, ldc = header.n3;
+			const MatrixBaseType *sharedA = shared;
+			const MatrixBaseType *sharedB = sharedA + (size_t) header.n1 * lda;
+			MatrixBaseType *sharedC = (MatrixBaseType *) sharedB + (size_t) header.n2 * ldb;
+			MatrixBaseType *tile = sharedC + header.rowBegin * ldc + header.colBegin;
+			int tileCols = header.colEnd - header.colBegin;
 
 			/**
-			 * Closing unused file descriptors
+			 * With MATRIX_MUL_SPECULATE another worker may be
+			 * computing the same tile: accumulate privately and only
+			 * store the finished values, which are the same for both
 			 */
-			close(matMul -> fileDescParentToWorkers[workerProcessPoolIdDisplay][1]);
-
-                        for(secondCounter = 0; secondCounter < n3; secondCounter++)
-                        {
-				sum = 0;
-				for(thirdCounter = 0; thirdCounter < n2; thirdCounter++)
+			if(matMul -> flags & MATRIX_MUL_SPECULATE)
+			{
+				if(!reserve(&products[0], &productCapacities[0], (size_t) nRows * tileCols))
+				{
+					error("worker %d: out of memory", index);
+					_exit(EXIT_FAILURE);
+				}
+				computeRows(sharedA + header.rowBegin * lda, lda, sharedB + header.colBegin, ldb,
+					    products[0], tileCols, nRows, header.n2, tileCols);
+				for(int i = 0; i < nRows; i++)
 				{
-				 	ssize_t numRead;
-                      			if((numRead = read(matMul -> fileDescParentToWorkers[workerProcessPoolIdDisplay][0], &multiplicandElementR, sizeof(multiplicandElementR))) == -1 ) 
-					{
-	                                    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Error writing to pipe : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-
-					}
-                                	else if(numRead == 0) 
-					{
-	  				    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Pipe closed : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-                                	}
-
-                      			if((numRead = read(matMul -> fileDescParentToWorkers[workerProcessPoolIdDisplay][0], &multiplierElementR, sizeof(multiplierElementR))) == -1 ) 
-					{
-	    				    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Error writing to pipe : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-
-                                	}
-	
-         	                        else if(numRead == 0) 
-					{
-					    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Pipe closed : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-
-                                 	}
-
-					/**
-					 * Perform Matrix Multiplication
-					 */
-	
-	                                 sum += multiplicandElementR * multiplierElementR;
- 
+					memcpy(tile + i * ldc, products[0] + (size_t) i * tileCols, tileCols * sizeof(MatrixBaseType));
 				}
+			}
+			else
+			{
+				computeRows(sharedA + header.rowBegin * lda, lda, sharedB + header.colBegin, ldb,
+					    tile, ldc, nRows, header.n2, tileCols);
+			}
+			if(traceRing != NULL)
+			{
+				logTile(traceRing, &header, index);
+			}
+
+			announceReady(readyFd, index);
+			MessageHeader reply = header;
+			reply.type = MSG_SHARED_DONE;
+			if(sendMessage(resultFd, &reply, NULL, 0) < 0)
+			{
+				error("worker %d: cannot write result:", index);
+				_exit(EXIT_FAILURE);
+			}
+			continue;
+		}
+
+		MatrixBaseType **product = &products[nextProduct];
+		size_t *productCapacity = &productCapacities[nextProduct];
+		nextProduct = zeroCopy ? (nextProduct + 1) % TASK_RING : 0;
+		if(!reserve(&rows, &rowsCapacity, (size_t) nRows * n2) ||
+		   !reserve(product, productCapacity, (size_t) nRows * nCols))
+		{
+			error("worker %d: out of memory", index);
+			_exit(EXIT_FAILURE);
+		}
+		if(nRows * n2 > 0 && readFully(taskFd, rows, (size_t) nRows * n2 * sizeof(MatrixBaseType)) <= 0)
+		{
+			error("worker %d: cannot read task data:", index);
+			_exit(EXIT_FAILURE);
+		}
+
+		/**
+		 * Perform the dot products of the task rows with every column
+		 * Enable/Disable trace flag
+		 * If flag is true then record the tile for the trace
+		 */
+		computeRows(rows, n2, b, nCols, *product, nCols, nRows, n2, nCols);
+		if(traceRing != NULL)
+		{
+			logTile(traceRing, &header, index);
+		}
+
+		/**
+		 * Send the product rows back to the client
+		 */
+		announceReady(readyFd, index);
+		MessageHeader reply = header;
+		reply.type = MSG_RESULT;
+		if(spliceMessage(resultFd, &reply, *product, (size_t) nRows * nCols * sizeof(MatrixBaseType), &zeroCopy) < 0)
+		{
+			error("worker %d: cannot write result:", index);
+			_exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Close the client ends of the pipes of workers [0, nWorkers) and wait
+ * for those workers to exit.
+ */
+static void
+stopWorkers(struct MatrixMul *matMul, int nWorkers)
+{
+	for(int i = 0; i < nWorkers; i++)
+	{
+		close(matMul -> fileDescParentToWorkers[i][1]);	// worker sees end of file
+		close(matMul -> fileDescWorkersToParent[i][0]);
+	}
+	for(int i = 0; i < nWorkers; i++)
+	{
+		waitpid(matMul -> workers[i], NULL, 0);
+	}
+}
+
+/**
+ * Free the memory of a multiplier; its workers must already be stopped.
+ */
+static void
+freeMemory(struct MatrixMul *matMul)
+{
+	if(matMul -> perfCounters != NULL)
+	{
+		for(int i = 0; i <= matMul -> noOfWorkers; i++)
+		{
+			closePerfCounters(&matMul -> perfCounters[i]);
+		}
+		free(matMul -> perfCounters);
+	}
+	for(int i = 0; i < matMul -> noOfWorkers; i++)
+	{
+		if(matMul -> fileDescParentToWorkers != NULL) free(matMul -> fileDescParentToWorkers[i]);
+		if(matMul -> fileDescWorkersToParent != NULL) free(matMul -> fileDescWorkersToParent[i]);
+	}
+	free(matMul -> fileDescParentToWorkers);
+	free(matMul -> fileDescWorkersToParent);
+	free(matMul -> workers);
+	free(matMul -> packedB);
+	free(matMul -> io);
+	free(matMul -> chunks);
+	free(matMul -> traceOwners);
+	if(matMul -> traceRings != NULL)
+	{
+		munmap(matMul -> traceRings, matMul -> noOfWorkers * sizeof(TraceRing));
+	}
+	if(matMul -> ioCounters != NULL)
+	{
+		munmap(matMul -> ioCounters, (matMul -> noOfWorkers + 1) * sizeof(IoCounters));
+	}
+	for(int i = 0; i < FDCONSTANT; i++)
+	{
+		if(matMul -> readyPipe[i] >= 0) close(matMul -> readyPipe[i]);
+	}
+	if(matMul -> shared != NULL)
+	{
+		munmap(matMul -> shared, matMul -> sharedBytes);
+	}
+	if(matMul -> sharedFd >= 0)
+	{
+		close(matMul -> sharedFd);
+	}
+	free(matMul);
+}
+
+
+/** Return a multi-process matrix multiplier with nWorkers worker
+ *  processes, or one per CPU available to the caller if nWorkers is
+ *  0.  Set *err to an appropriate error number (documented in
+ *  errno(3)) on error.
+ *
+ *  If trace is not NULL, turn on tracing for calls to mulMatrixMul()
+ *  using returned MatrixMul.  Specifically, each dot-product
+ *  computation must be logged to trace as a line in the form:
+ *
+ *  INDEX[PID]: [I]x[J] = Z
+ *
+ *  where INDEX in [0, nWorkers) is the index of the worker and PID is
+ *  its pid, I is the index of the row in the multiplicand, J is the
+ *  index of the row in the multiplier and Z is their dot-product
+ *  computed by child process PID.  The spacing must be exactly as
+ *  shown above and all values must be output in decimal with no
+ *  leading zeros or redundant + signs.
+ *
+ */
+MatrixMul *
+newMatrixMul(int nWorkers, FILE *trace, int *err)
+{
+	return newMatrixMulWithOptions(nWorkers, trace, NULL, err);
+}
+
+/**
+ * Turn on the flags named in the MATRIX_MUL_OPTIONS environment variable.
+ */
+void
+initMatrixMulOptions(MatrixMulOptions *options)
+{
+	options -> flags = 0;
+	const char *idle = getenv("MATRIX_MUL_IDLE_MS");
+	options -> idleMs = (idle != NULL) ? (unsigned) strtoul(idle, NULL, 10) : WARM_IDLE_MS;
+
+	const char *names = getenv("MATRIX_MUL_OPTIONS");
+	if(names == NULL)
+	{
+		return;
+	}
+
+	static const struct { const char *name; unsigned flag; } optionNames[] = {
+		{ "shared-data", MATRIX_MUL_SHARED_DATA },
+		{ "zero-copy", MATRIX_MUL_ZERO_COPY },
+		{ "tiles", MATRIX_MUL_TILES },
+		{ "pin", MATRIX_MUL_PIN_WORKERS },
+		{ "pin-parent", MATRIX_MUL_PIN_PARENT },
+		{ "speculate", MATRIX_MUL_SPECULATE },
+		{ "threads", MATRIX_MUL_THREADS },
+		{ "warm-pool", MATRIX_MUL_WARM_POOL },
+	};
+	for(const char *p = names; *p != '\0'; )
+	{
+		size_t len = strcspn(p, ",");
+		for(size_t i = 0; i < sizeof(optionNames) / sizeof(optionNames[0]); i++)
+		{
+			if(strlen(optionNames[i].name) == len && strncmp(p, optionNames[i].name, len) == 0)
+			{
+				options -> flags |= optionNames[i].flag;
+			}
+		}
+		p += len + (p[len] == ',');
+	}
+}
+
+/**
+ * Pin the client to cpu for the life of matMul, remembering its
+ * affinity *allowed to restore.
+ */
+static void
+pinClient(struct MatrixMul *matMul, const cpu_set_t *allowed, int cpu)
+{
+	matMul -> parentAffinity = *allowed;
+	matMul -> parentPinned = (pinToCpu(cpu) == 0);
+}
+
+/**
+ * Restore the affinity of the client if matMul pinned it.
+ */
+static void
+unpinClient(struct MatrixMul *matMul)
+{
+	if(matMul -> parentPinned)
+	{
+		sched_setaffinity(0, sizeof(matMul -> parentAffinity), &matMul -> parentAffinity);
+		matMul -> parentPinned = false;
+	}
+}
+
+/**
+ * Warm pool of parked multipliers, defined at the end of this file
+ */
+static struct MatrixMul *leaseWarm(int nWorkers, unsigned flags, _Bool traceFlag, _Bool perfFlag);
+static _Bool parkWarm(struct MatrixMul *matMul);
+
+/**
+ * Optional hardware counters for the client and each worker process.
+ * Without worker processes (MATRIX_MUL_THREADS) only the client set is
+ * opened, before the threads are created so that it counts them too.
+ */
+static void
+openPerf(struct MatrixMul *matMul)
+{
+	if(!matMul -> perfFlag)
+	{
+		return;
+	}
+	matMul -> perfCounters = malloc(sizeof(PerfCounters) * (matMul -> noOfWorkers + 1));
+	if(matMul -> perfCounters == NULL)
+	{
+		matMul -> perfFlag = false;
+		return;
+	}
+	openPerfCounters(&matMul -> perfCounters[0], 0);
+	for(int i = 0; i < matMul -> noOfWorkers; i++)
+	{
+		if(matMul -> workers != NULL)
+		{
+			openPerfCounters(&matMul -> perfCounters[1 + i], matMul -> workers[i]);
+		}
+		else
+		{
+			memset(matMul -> perfCounters[1 + i].fds, -1, sizeof(matMul -> perfCounters[1 + i].fds));
+			memset(matMul -> perfCounters[1 + i].inGroup, 0, sizeof(matMul -> perfCounters[1 + i].inGroup));
+		}
+	}
+}
 
-				/**
-				 * Enable/Disable trace flag
-				 * If flag is true then log the output in the required format
-				 * If flag is false then no need to log the output
-				 * Shown the ith row of multiplicand and ith column of multiplier, product, worker process id and its pool index 
-				 */
-
-				if(matMul -> traceFlag)
-                                {
-                                     fprintf(stdout, "%d[%d]: [%d]x[%d] = %d\n", 
-								workerProcessPoolIdDisplay, 
-									matMul-> workers[workerProcessPoolIdDisplay], 
-											firstCounter, secondCounter, sum);
-                                }
-
-				/**
-				 * Send the dot-product performed by the typical worker to the client process 
-				 * To update sum in final matrix
-				 */
-
-				 if(write(matMul -> fileDescWorkersToParent[workerProcessPoolIdDisplay][1], &sum, sizeof(sum)) == -1 ) 
-				 {
-					    cleanUpFlag = 1;
-                                            *err = errno;
-                                            fatal("Pipe closed : \n");
-                                            freeMatrixMul((struct MatrixMul *) matMul, err);
-                                            exit(EXIT_FAILURE);
-        		         }
-                        }
-	
-        }
+/**
+ * Construct a multiplier as documented for newMatrixMul() with the
+ * given options.
+ */
+MatrixMul *
+newMatrixMulWithOptions(int nWorkers, FILE *trace, const MatrixMulOptions *options, int *err)
+{
+	MatrixMulOptions defaults;
+	if(options == NULL)
+	{
+		initMatrixMulOptions(&defaults);
+		options = &defaults;
+	}
 
+	if(nWorkers < 0)
+	{
+		*err = EINVAL;
+		return NULL;
+	}
 
 	/**
-	 * The Variable holds the final result of final matrix
+	 * CPUs available to the pool.  With MATRIX_MUL_PIN_PARENT the first
+	 * of them is kept for the client and the workers use the others
+	 * (all of them if there is only one).  nWorkers == 0 means one
+	 * worker per available CPU.
 	 */
-	MatrixBaseType result = 0;
+	cpu_set_t allowed;
+	int cpus[CPU_SETSIZE];
+	int nCpus = allowedCpus(&allowed, cpus);
+	_Bool pinParent = (options -> flags & MATRIX_MUL_PIN_PARENT) && nCpus > 1;
+	int *workerCpus = pinParent ? cpus + 1 : cpus;
+	int nWorkerCpus = pinParent ? nCpus - 1 : nCpus;
+	if(nWorkers == 0)
+	{
+		nWorkers = (nWorkerCpus > 0) ? nWorkerCpus : 1;
+	}
 
 	/**
-	 * This is used to retrieve product performed by each worker and
-	 * update the result into the final matrix by the parent
+	 * A parked multiplier of the same configuration, with its workers
+	 * already running, if there is one
 	 */
-	MatrixBaseType workerProcessPoolId = 0;
+	_Bool perfFlag = (getenv("MATRIX_MUL_PERF") != NULL);
+	struct MatrixMul *matrixMul = NULL;
+	if(options -> flags & MATRIX_MUL_WARM_POOL)
+	{
+		matrixMul = leaseWarm(nWorkers, options -> flags, trace != NULL, perfFlag);
+	}
+	if(matrixMul != NULL)
+	{
+		matrixMul -> trace = trace;
+		matrixMul -> idleMs = options -> idleMs;
+		if(pinParent)
+		{
+			pinClient(matrixMul, &allowed, cpus[0]);
+		}
+		return matrixMul;
+	}
 
-        for(firstCounter = 0; firstCounter < n1; firstCounter++)
-        {
-		/**
-		 * Remember which typical worker sending the data to the client 
-		 */
-		workerProcessPoolId = (workerProcessPoolId + 1) % matMul -> noOfWorkers;		
-
-                for(secondCounter = 0; secondCounter < n3; secondCounter++)
-                {
-                                ssize_t numRead;
-                                if((numRead = read(matMul -> fileDescWorkersToParent[workerProcessPoolId][0], &result, sizeof(result))) == -1)
-                                {
-					 cleanUpFlag = 1;
-                                         *err = errno;
-                                         fatal("Error reading from the pipe : \n");
-                                         freeMatrixMul((struct MatrixMul *) matMul, err);
-                                         exit(EXIT_FAILURE);
-
-                                }
-                                else if(numRead == 0) 
-				{
-					  cleanUpFlag = 1;
-                                          *err = errno;
-                                          fatal("Pipe closed : \n");
-                                          freeMatrixMul((struct MatrixMul *) matMul, err);
-                                          exit(EXIT_FAILURE);
-
-                                }
-                                else 
-				{
-                                 	c[firstCounter][secondCounter] = result;
-                                }
-                }
-        }
+	/**
+	 * Memory allocation
+	 */
+ 	matrixMul = calloc(1, sizeof(struct MatrixMul));
+	if(matrixMul == NULL)
+	{
+		*err = errno;		     // set error no
+		return NULL;
+	}
 
+	matrixMul -> noOfWorkers = nWorkers;	// number of worker processes
+	matrixMul -> flags = options -> flags;
+	matrixMul -> sharedFd = -1;
+	matrixMul -> zeroCopy = (matrixMul -> flags & MATRIX_MUL_ZERO_COPY) && canVmsplice();
+	matrixMul -> readyPipe[0] = matrixMul -> readyPipe[1] = -1;
+	matrixMul -> traceFlag = (trace != NULL);	// enable/disable log for the output
+	matrixMul -> trace = trace;
+	matrixMul -> perfFlag = perfFlag;
+	matrixMul -> idleMs = options -> idleMs;
 
 	/**
-	 * Removed or close the file descriptors after finishing the task
-	 *
+	 * Thread backend: a pool of threads in this process, with the same
+	 * CPU placement as worker processes would get
 	 */
-	 for(MatrixBaseType removeCounter = 0 ; removeCounter < matMul -> noOfWorkers; removeCounter++)
-	 {
-		close(matMul -> fileDescParentToWorkers[removeCounter][0]);
-		close(matMul -> fileDescWorkersToParent[removeCounter][0]);
-		close(matMul -> fileDescParentToWorkers[removeCounter][1]);
-                close(matMul -> fileDescWorkersToParent[removeCounter][1]);
-	 }
-
+	if(matrixMul -> flags & MATRIX_MUL_THREADS)
+	{
+		openPerf(matrixMul);
+		_Bool pinWorkers = (matrixMul -> flags & MATRIX_MUL_PIN_WORKERS) && nWorkerCpus > 0;
+		matrixMul -> threads = newMatrixMulThreads(nWorkers, pinWorkers ? workerCpus : NULL, nWorkerCpus, err);
+		if(matrixMul -> threads == NULL)
+		{
+			freeMemory(matrixMul);
+			return NULL;
+		}
+		if(pinParent)
+		{
+			pinClient(matrixMul, &allowed, cpus[0]);
+		}
+		matrixMul -> reusable = true;
+		return matrixMul;
+	}
 
 	/**
-	 * Wait for all child processes to finish and exit
+	 * Worker pids and one pipe pair per worker; each pipe has
+	 * FDCONSTANT file descriptors - 0 for reading and 1 for writing
 	 */
-        for(waitCounter = 0; waitCounter < matMul -> noOfWorkers; waitCounter++)
-        {
-                waitpid(matMul-> workers[waitCounter], &status, 0);
-        }
+	matrixMul -> workers = calloc(nWorkers, sizeof(pid_t));
+	matrixMul -> fileDescParentToWorkers = calloc(nWorkers, sizeof(int *));
+	matrixMul -> fileDescWorkersToParent = calloc(nWorkers, sizeof(int *));
+	matrixMul -> io = calloc(nWorkers, sizeof(WorkerIo));
+	if(matrixMul -> workers == NULL || matrixMul -> fileDescParentToWorkers == NULL ||
+	   matrixMul -> fileDescWorkersToParent == NULL || matrixMul -> io == NULL)
+	{
+		*err = errno;			// set error no
+		freeMemory(matrixMul);
+		return NULL;
+	}
+	for(int counter = 0; counter < nWorkers; counter++)
+	{
+		matrixMul -> fileDescParentToWorkers[counter] = malloc(sizeof(int) * FDCONSTANT);
+		matrixMul -> fileDescWorkersToParent[counter] = malloc(sizeof(int) * FDCONSTANT);
+		if(matrixMul -> fileDescParentToWorkers[counter] == NULL ||
+		   matrixMul -> fileDescWorkersToParent[counter] == NULL)
+		{
+			*err = errno;		// set error no
+			freeMemory(matrixMul);
+			return NULL;
+		}
+	}
 
-	// Done Multi-process Matrix Multiplier with Client and Worker processes	
+	/**
+	 * Shared data region, set up before forking so that every worker
+	 * inherits it
+	 */
+	if(matrixMul -> flags & MATRIX_MUL_SHARED_DATA)
+	{
+		matrixMul -> sharedFd = memfd_create("matrix_mul", 0);
+		if(matrixMul -> sharedFd < 0 || ftruncate(matrixMul -> sharedFd, SHARED_INITIAL_BYTES) < 0)
+		{
+			*err = errno;
+			freeMemory(matrixMul);
+			return NULL;
+		}
+		matrixMul -> shared = mmap(NULL, SHARED_INITIAL_BYTES, PROT_READ | PROT_WRITE,
+					   MAP_SHARED, matrixMul -> sharedFd, 0);
+		if(matrixMul -> shared == MAP_FAILED)
+		{
+			*err = errno;
+			matrixMul -> shared = NULL;
+			freeMemory(matrixMul);
+			return NULL;
+		}
+		matrixMul -> sharedBytes = SHARED_INITIAL_BYTES;
+	}
+
+	/**
+	 * Ready channel shared by all workers
+	 */
+	if(pipe(matrixMul -> readyPipe) < 0)
+	{
+		*err = errno;
+		matrixMul -> readyPipe[0] = matrixMul -> readyPipe[1] = -1;
+		freeMemory(matrixMul);
+		return NULL;
+	}
+
+	/**
+	 * Trace rings, set up before forking so that every worker inherits
+	 * its own
+	 */
+	if(matrixMul -> traceFlag)
+	{
+		matrixMul -> traceRings = mmap(NULL, nWorkers * sizeof(TraceRing), PROT_READ | PROT_WRITE,
+					       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if(matrixMul -> traceRings == MAP_FAILED)
+		{
+			*err = errno;
+			matrixMul -> traceRings = NULL;
+			freeMemory(matrixMul);
+			return NULL;
+		}
+	}
+
+	/**
+	 * I/O counters, shared in the same way
+	 */
+	matrixMul -> ioCounters = mmap(NULL, (nWorkers + 1) * sizeof(IoCounters), PROT_READ | PROT_WRITE,
+				       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(matrixMul -> ioCounters == MAP_FAILED)
+	{
+		*err = errno;
+		matrixMul -> ioCounters = NULL;
+		freeMemory(matrixMul);
+		return NULL;
+	}
+
+	/**
+	 * Flush pending output so that it is not duplicated by the
+	 * workers
+	 */
+	fflush(NULL);
+
+	/**
+	 * Creating worker process pool.
+         * Creating pipes for parent - children process and children - parent communication
+         * Setting up error codes
+         */
+	for(int worker_counter = 0; worker_counter < nWorkers; worker_counter++)
+        {
+		int *toWorker = matrixMul -> fileDescParentToWorkers[worker_counter];
+		int *fromWorker = matrixMul -> fileDescWorkersToParent[worker_counter];
+
+		/**
+		 * creating pipes pair
+		 */
+		if(pipe(toWorker) < 0)
+		{
+			*err = errno;
+			stopWorkers(matrixMul, worker_counter);
+			freeMemory(matrixMul);
+			return NULL;
+		}
+		if(pipe(fromWorker) < 0)
+		{
+			*err = errno;
+			close(toWorker[0]);
+			close(toWorker[1]);
+			stopWorkers(matrixMul, worker_counter);
+			freeMemory(matrixMul);
+			return NULL;
+		}
+
+		if(matrixMul -> zeroCopy)
+		{
+			enlargePipe(toWorker[1]);
+			enlargePipe(fromWorker[1]);
+		}
+
+		/**
+		 * fork error checking
+		 */
+		if((matrixMul -> workers[worker_counter] = fork()) == -1)
+		{
+			*err = errno;
+			close(toWorker[0]);
+			close(toWorker[1]);
+			close(fromWorker[0]);
+			close(fromWorker[1]);
+			stopWorkers(matrixMul, worker_counter);
+			freeMemory(matrixMul);
+			return NULL;
+		}
+
+		/**
+		 * worker process: keep only its own ends of its own pipes,
+		 * closing the client ends inherited from the workers created
+		 * before it and from other multipliers, then serve tasks
+		 * until the client closes the pipe
+		 */
+		else if(matrixMul -> workers[worker_counter] == 0)
+		{
+			int keep[] = { toWorker[0], fromWorker[1], matrixMul -> readyPipe[1], matrixMul -> sharedFd };
+			closeInheritedFds(keep, sizeof(keep) / sizeof(keep[0]));
+
+			/**
+			 * Each worker on its own CPU while there are enough of
+			 * them, wrapping around otherwise
+			 */
+			if((matrixMul -> flags & MATRIX_MUL_PIN_WORKERS) && nWorkerCpus > 0 &&
+			   pinToCpu(workerCpus[worker_counter % nWorkerCpus]) < 0)
+			{
+				error("worker %d: cannot set CPU affinity:", worker_counter);
+			}
+			runWorker(matrixMul, worker_counter);
+		}
+
+		/**
+		 * client process: keep the other ends
+		 */
+		close(toWorker[0]);
+		close(fromWorker[1]);
+		if(fcntl(toWorker[1], F_SETFL, O_NONBLOCK) < 0 || fcntl(fromWorker[0], F_SETFL, O_NONBLOCK) < 0)
+		{
+			*err = errno;
+			stopWorkers(matrixMul, worker_counter + 1);
+			freeMemory(matrixMul);
+			return NULL;
+		}
+	}
+
+	/**
+	 * Only the workers write to the ready channel
+	 */
+	close(matrixMul -> readyPipe[1]);
+	matrixMul -> readyPipe[1] = -1;
+	if(fcntl(matrixMul -> readyPipe[0], F_SETFL, O_NONBLOCK) < 0)
+	{
+		*err = errno;
+		stopWorkers(matrixMul, nWorkers);
+		freeMemory(matrixMul);
+		return NULL;
+	}
+
+	/**
+	 * The client on its own CPU, once the workers have been forked
+	 * with the original affinity
+	 */
+	if(pinParent)
+	{
+		pinClient(matrixMul, &allowed, cpus[0]);
+	}
+
+	openPerf(matrixMul);
+	matrixMul -> reusable = true;
+	return matrixMul;	 		// return matrix multiplier structure to be used further
+}
+
+/**
+ * Stop the workers of matMul and free it.
+ */
+static void
+destroyMatrixMul(struct MatrixMul *matMul)
+{
+	/**
+	 * Closing the task pipes tells each worker to exit
+	 */
+	if(matMul -> threads != NULL)
+	{
+		freeMatrixMulThreads(matMul -> threads);
+	}
+	else
+	{
+		stopWorkers(matMul, matMul -> noOfWorkers);
+	}
+	freeMemory(matMul);
+}
+
+/** Free all resources used by matMul.  Specifically, free all memory
+ *  and return only after all child processes have been set up to
+ *  exit.  Set *err appropriately (as documented in errno(3)) on error.
+ */
+void
+freeMatrixMul(MatrixMul *matMul, int *err)
+{
+	if(matMul == NULL)
+	{
+		*err = EINVAL;
+		return;
+	}
+
+	unpinClient(matMul);
+	if((matMul -> flags & MATRIX_MUL_WARM_POOL) && parkWarm(matMul))
+	{
+		return;
+	}
+	destroyMatrixMul(matMul);
+}
+
+/**
+ * Start the hardware counters of the client and all workers.
+ */
+static void
+startPerf(const MatrixMul *matMul)
+{
+	for(int i = 0; i <= matMul -> noOfWorkers; i++)
+	{
+		startPerfCounters(&matMul -> perfCounters[i]);
+	}
+}
+
+/**
+ * Stop the hardware counters and report their sum to the debug trace
+ * and, when tracing is enabled, as a comment line in the trace output.
+ */
+static void
+stopPerf(const MatrixMul *matMul, int n1, int n2, int n3)
+{
+	PerfSample total;
+	memset(&total, 0, sizeof(total));
+	for(int i = 0; i <= matMul -> noOfWorkers; i++)
+	{
+		PerfSample sample;
+		stopPerfCounters(&matMul -> perfCounters[i], &sample);
+		addPerfSample(&total, &sample);
+	}
+
+	char perfText[256];
+	formatPerfSample(&total, 1, perfText, sizeof(perfText));
+	TRACE("mulMatrixMul %dx%dx%d: %s\n", n1, n2, n3, perfText);
+	if(matMul -> traceFlag)
+	{
+		fprintf(matMul -> trace, "# perf mulMatrixMul %dx%dx%d: %s\n", n1, n2, n3, perfText);
+	}
+}
+
+/**
+ * Copy a and b into the shared data region (MATRIX_MUL_SHARED_DATA),
+ * growing it by doubling if needed; the workers remap when they see
+ * the new size in a task header.  Return false with *err set on error.
+ */
+static _Bool
+prepareShared(struct MatrixMul *matMul, int n1, int n2, int n3,
+	      const MatrixBaseType *a, const MatrixBaseType *b, int *err)
+{
+	size_t aCount = (size_t) n1 * n2, bCount = (size_t) n2 * n3, cCount = (size_t) n1 * n3;
+	size_t bytes = (aCount + bCount + cCount) * sizeof(MatrixBaseType);
+	if(bytes > matMul -> sharedBytes)
+	{
+		size_t newBytes = matMul -> sharedBytes;
+		while(newBytes < bytes)
+		{
+			newBytes *= 2;
+		}
+		if(ftruncate(matMul -> sharedFd, newBytes) < 0)
+		{
+			*err = errno;
+			return false;
+		}
+		void *p = mremap(matMul -> shared, matMul -> sharedBytes, newBytes, MREMAP_MAYMOVE);
+		if(p == MAP_FAILED)
+		{
+			*err = errno;
+			return false;
+		}
+		matMul -> shared = p;
+		matMul -> sharedBytes = newBytes;
+	}
+	memcpy(matMul -> shared, a, aCount * sizeof(MatrixBaseType));
+	memcpy(matMul -> shared + aCount, b, bCount * sizeof(MatrixBaseType));
+	return true;
+}
+
+/**
+ * A vertical panel of the product, columns [colBegin, colEnd), and the
+ * group of workers computing it: worker w belongs to panel
+ * w % nPanels.  Without MATRIX_MUL_TILES there is a single panel
+ * covering all of c.
+ */
+typedef struct Panel {
+     int colBegin;
+     int colEnd;
+     int nWorkers;		// workers in the group
+     int nextRow;		// first row of the panel not assigned yet
+     const MatrixBaseType *b;	// b[n2][colBegin, colEnd), contiguous
+} Panel;
+
+/**
+ * A multiplication in progress
+ */
+typedef struct Dispatch {
+     struct MatrixMul *matMul;
+     unsigned generation;	// number of this call
+     int n1, n2, n3;
+     const MatrixBaseType *a;
+     MatrixBaseType *c;
+     int minRows;		// smallest guided chunk
+     int nChunks;		// chunks in matMul -> chunks
+     int nDone;			// chunks whose result has been accepted
+     int nPanels;
+     Panel *panels;		// [nPanels]
+} Dispatch;
+
+/**
+ * Number of vertical panels of c for nWorkers workers.  A worker of a
+ * group of nWorkers / nPanels computes about n1 * nPanels / nWorkers
+ * rows of one panel, so it receives that many rows of a and n3 / nPanels
+ * columns of b; choose the number of panels minimizing that sum.
+ */
+static int
+choosePanels(int n1, int n3, int nWorkers)
+{
+	int best = 1;
+	double bestWords = 0;
+	for(int nPanels = 1; nPanels <= nWorkers && nPanels <= n3; nPanels++)
+	{
+		double words = (double) n1 * nPanels / nWorkers + (double) n3 / nPanels;
+		if(nPanels == 1 || words < bestWords)
+		{
+			best = nPanels;
+			bestWords = words;
+		}
+	}
+	return best;
+}
+
+/**
+ * Split the columns of c into nPanels panels, each as wide as its
+ * share of the workers, and make the panels of b contiguous when they
+ * are to be sent (needB): b itself for a single panel, otherwise copies
+ * in the packedB buffer of matMul.  Return false with *err set on
+ * error.
+ */
+static _Bool
+setupPanels(struct MatrixMul *matMul, Panel *panels, int nPanels, int n2, int n3,
+	    const MatrixBaseType *b, _Bool needB, int *err)
+{
+	int nWorkers = matMul -> noOfWorkers;
+	MatrixBaseType *packed = NULL;
+	if(nPanels > 1 && needB)
+	{
+		if(!reserve(&matMul -> packedB, &matMul -> packedCapacity, (size_t) n2 * n3))
+		{
+			*err = ENOMEM;
+			return false;
+		}
+		packed = matMul -> packedB;
+	}
+
+	int workersBefore = 0;
+	size_t packedOffset = 0;
+	for(int i = 0; i < nPanels; i++)
+	{
+		Panel *panel = &panels[i];
+		panel -> nWorkers = nWorkers / nPanels + (i < nWorkers % nPanels);
+		panel -> colBegin = (int) ((long long) n3 * workersBefore / nWorkers);
+		workersBefore += panel -> nWorkers;
+		panel -> colEnd = (int) ((long long) n3 * workersBefore / nWorkers);
+		panel -> nextRow = 0;
+		panel -> b = b;
+		if(packed != NULL)
+		{
+			int width = panel -> colEnd - panel -> colBegin;
+			MatrixBaseType *dst = packed + packedOffset;
+			for(int k = 0; k < n2; k++)
+			{
+				memcpy(dst + (size_t) k * width, b + (size_t) k * n3 + panel -> colBegin,
+				       width * sizeof(MatrixBaseType));
+			}
+			panel -> b = dst;
+			packedOffset += (size_t) n2 * width;
+		}
+	}
+	return true;
+}
+
+/**
+ * Queue chunk number chunk of the current call at worker.
+ */
+static void
+queueTask(Dispatch *d, int worker, int chunk)
+{
+	WorkerIo *io = &d -> matMul -> io[worker];
+	const Panel *panel = &d -> panels[worker % d -> nPanels];
+	io -> tasks[(io -> head + io -> count) % TASK_RING] = (Task) {
+		.generation = d -> generation, .chunk = chunk,
+		.rowBegin = d -> matMul -> chunks[chunk].rowBegin, .rowEnd = d -> matMul -> chunks[chunk].rowEnd,
+		.colBegin = panel -> colBegin, .colEnd = panel -> colEnd,
+	};
+	io -> count++;
+}
+
+/**
+ * Queue the next guided chunk of its panel for worker, if rows remain
+ * and its ring has room.  Return 1 if a chunk was queued, 0 if not and
+ * -1 with errno set on error.
+ */
+static int
+assignChunk(Dispatch *d, int worker)
+{
+	struct MatrixMul *matMul = d -> matMul;
+	Panel *panel = &d -> panels[worker % d -> nPanels];
+	if(panel -> nextRow >= d -> n1 || matMul -> io[worker].count == TASK_RING)
+	{
+		return 0;
+	}
+	if(d -> nChunks == (int) matMul -> chunksCapacity)
+	{
+		size_t capacity = (matMul -> chunksCapacity > 0) ? 2 * matMul -> chunksCapacity : 64;
+		Chunk *chunks = realloc(matMul -> chunks, capacity * sizeof(Chunk));
+		if(chunks == NULL)
+		{
+			return -1;
+		}
+		matMul -> chunks = chunks;
+		matMul -> chunksCapacity = capacity;
+	}
+
+	Chunk *chunk = &matMul -> chunks[d -> nChunks];
+	chunk -> rowBegin = panel -> nextRow;
+	panel -> nextRow += guidedChunk(d -> n1 - panel -> nextRow, panel -> nWorkers, d -> minRows);
+	chunk -> rowEnd = panel -> nextRow;
+	chunk -> worker = worker;
+	chunk -> speculated = chunk -> claimed = false;
+	queueTask(d, worker, d -> nChunks++);
+	return 1;
+}
+
+/**
+ * Speculative re-dispatch: give an idle worker, whose panel has no
+ * rows left to hand out, a duplicate of the oldest chunk of its panel
+ * still outstanding at another worker, unless every such chunk has
+ * already been duplicated once.  Return true if a chunk was queued.
+ */
+static _Bool
+speculate(Dispatch *d, int worker)
+{
+	struct MatrixMul *matMul = d -> matMul;
+	if(!(matMul -> flags & MATRIX_MUL_SPECULATE) || matMul -> io[worker].count > 0)
+	{
+		return false;
+	}
+	for(int i = 0; i < d -> nChunks; i++)
+	{
+		Chunk *chunk = &matMul -> chunks[i];
+		if(!chunk -> claimed && !chunk -> speculated && chunk -> worker != worker &&
+		   chunk -> worker % d -> nPanels == worker % d -> nPanels)
+		{
+			chunk -> speculated = true;
+			queueTask(d, worker, i);
+			TRACE("speculating rows [%d, %d) of worker %d on worker %d\n",
+			      chunk -> rowBegin, chunk -> rowEnd, chunk -> worker, worker);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Answer the outstanding ready announcements of worker with chunks,
+ * or with duplicates of chunks of stragglers once none are left.
+ * Return -1 with errno set on error, else 0.
+ */
+static int
+answerReady(Dispatch *d, int worker)
+{
+	WorkerIo *io = &d -> matMul -> io[worker];
+	while(io -> wanted > 0)
+	{
+		int queued = assignChunk(d, worker);
+		if(queued < 0)
+		{
+			return -1;
+		}
+		if(queued == 0 && !speculate(d, worker))
+		{
+			break;
+		}
+		io -> wanted--;
+	}
+	return 0;
+}
+
+/**
+ * Return true if worker has a message which is not completely written.
+ */
+static _Bool
+hasPendingTasks(const WorkerIo *io)
+{
+	return io -> outCount > 0 || io -> sendB || io -> nSent < io -> count;
+}
+
+/**
+ * Return true if a message to or from worker is partly transferred.
+ */
+static _Bool
+hasPartialMessage(const WorkerIo *io)
+{
+	return io -> outCount > 0 || io -> inDone > 0;
+}
+
+/**
+ * Write as much of the pending messages of worker as its task pipe
+ * accepts without blocking: the multiplier first, then the queued
+ * chunks in order.  Return -1 with errno set on error, else 0.
+ */
+static int
+writeTasks(Dispatch *d, int worker)
+{
+	struct MatrixMul *matMul = d -> matMul;
+	WorkerIo *io = &matMul -> io[worker];
+	const Panel *panel = &d -> panels[worker % d -> nPanels];
+	_Bool shared = (matMul -> flags & MATRIX_MUL_SHARED_DATA) != 0;
+	int fd = matMul -> fileDescParentToWorkers[worker][1];
+
+	while(1)
+	{
+		if(io -> outCount == 0)
+		{
+			MessageHeader *header = &io -> outHeader;
+			const void *data = NULL;
+			size_t size = 0;
+			if(io -> sendB)
+			{
+				*header = (MessageHeader) {
+					.type = MSG_MATRIX_B, .generation = d -> generation, .n2 = d -> n2, .n3 = d -> n3,
+					.colBegin = panel -> colBegin, .colEnd = panel -> colEnd,
+				};
+				data = panel -> b;
+				size = (size_t) d -> n2 * (panel -> colEnd - panel -> colBegin) * sizeof(MatrixBaseType);
+				io -> sendB = false;
+			}
+			else if(io -> nSent < io -> count)
+			{
+				const Task *task = &io -> tasks[(io -> head + io -> nSent++) % TASK_RING];
+				*header = (MessageHeader) {
+					.type = shared ? MSG_SHARED_ROWS : MSG_ROWS, .generation = task -> generation,
+					.rowBegin = task -> rowBegin, .rowEnd = task -> rowEnd,
+					.colBegin = task -> colBegin, .colEnd = task -> colEnd,
+					.n1 = d -> n1, .n2 = d -> n2, .n3 = d -> n3,
+					.sharedBytes = matMul -> sharedBytes,
+				};
+				if(!shared)
+				{
+					data = d -> a + (size_t) header -> rowBegin * d -> n2;
+					size = (size_t) (header -> rowEnd - header -> rowBegin) * d -> n2 * sizeof(MatrixBaseType);
+				}
+			}
+			else
+			{
+				return 0;			// nothing left to send
+			}
+			io -> out[0] = (struct iovec) { .iov_base = header, .iov_len = sizeof(*header) };
+			io -> out[1] = (struct iovec) { .iov_base = (void *) data, .iov_len = size };
+			io -> outCount = (size > 0) ? 2 : 1;
+			io -> outSplice = matMul -> zeroCopy && size >= ZEROCOPY_MIN_BYTES;
+			if(size == 0)
+			{
+				io -> out[1] = io -> out[0];	// keep the unwritten part at out[2 - outCount]
+			}
+		}
+
+		/**
+		 * The header is always copied, as outHeader is reused for the
+		 * next message; a spliced payload refers to the caller's a or
+		 * b, not to a copy.  A call returns once every message it
+		 * started is completely written and every chunk has a result,
+		 * but with MATRIX_MUL_SPECULATE that result may come from the
+		 * other copy of a duplicated chunk: the straggler's message can
+		 * still sit in its pipe, referring to pages of a or b which the
+		 * caller may rewrite or free once the call has returned.  This
+		 * is harmless only because the straggler's result is tagged
+		 * with the old generation and discarded by drainStale() or
+		 * readResults(); nothing computed from such a payload may ever
+		 * be used
+		 */
+		struct iovec *iov = &io -> out[2 - io -> outCount];
+		ssize_t n;
+		if(io -> outSplice && io -> outCount == 1)
+		{
+			n = vmsplice(fd, iov, 1, SPLICE_F_NONBLOCK);
+		}
+		else
+		{
+			n = writev(fd, iov, io -> outSplice ? 1 : io -> outCount);
+		}
+		countIo(matMul -> ioCounters, n, true);
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+			if(io -> outSplice && (errno == ENOSYS || errno == EINVAL))
+			{
+				matMul -> zeroCopy = false;	// fall back to copies
+				io -> outSplice = false;
+				continue;
+			}
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+		}
+
+		/**
+		 * Skip the buffers which were written completely and
+		 * advance into the one written partially
+		 */
+		while(io -> outCount > 0 && (size_t) n >= iov -> iov_len)
+		{
+			n -= iov -> iov_len;
+			iov++;
+			io -> outCount--;
+		}
+		if(io -> outCount > 0)
+		{
+			iov -> iov_base = (char *) iov -> iov_base + n;
+			iov -> iov_len -= n;
+		}
+	}
+}
+
+/**
+ * Consume the trace record of the result just read from worker; if
+ * the result was accepted (won), note the worker as the one of the
+ * (row, panel) entries of traceOwners it covers.  A worker appends the
+ * record of a tile before announcing its result, so the record of a
+ * result which has been read is always there.  Return -1 with errno
+ * set to EPROTO on a missing or malformed record.
+ */
+static int
+drainTrace(Dispatch *d, int worker, _Bool won)
+{
+	const struct MatrixMul *matMul = d -> matMul;
+	TraceRing *ring = &matMul -> traceRings[worker];
+	int panelIndex = worker % d -> nPanels;
+	const Panel *panel = &d -> panels[panelIndex];
+
+	unsigned tail = ring -> tail;
+	if(__atomic_load_n(&ring -> head, __ATOMIC_ACQUIRE) == tail)
+	{
+		errno = EPROTO;
+		return -1;
+	}
+	const TraceRecord *record = &ring -> records[tail % TRACE_RING];
+	if(won)
+	{
+		if(record -> rowBegin < 0 || record -> rowEnd > d -> n1 || record -> rowBegin > record -> rowEnd ||
+		   record -> colBegin != panel -> colBegin || record -> colEnd != panel -> colEnd)
+		{
+			errno = EPROTO;
+			return -1;
+		}
+		for(int row = record -> rowBegin; row < record -> rowEnd; row++)
+		{
+			matMul -> traceOwners[(size_t) row * d -> nPanels + panelIndex] = worker;
+		}
+	}
+	__atomic_store_n(&ring -> tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * Write the trace lines of the product c[n1][n3] to the trace output:
+ * every dot product, in row-major order, attributed to the worker
+ * whose result was accepted.
+ */
+static void
+writeTrace(const Dispatch *d)
+{
+	const struct MatrixMul *matMul = d -> matMul;
+	FILE *trace = matMul -> trace;
+	for(int row = 0; row < d -> n1; row++)
+	{
+		const MatrixBaseType *cRow = d -> c + (size_t) row * d -> n3;
+		for(int panelIndex = 0; panelIndex < d -> nPanels; panelIndex++)
+		{
+			const Panel *panel = &d -> panels[panelIndex];
+			int worker = matMul -> traceOwners[(size_t) row * d -> nPanels + panelIndex];
+			if(worker < 0)
+			{
+				continue;
+			}
+			int pid = (int) matMul -> workers[worker];
+			for(int col = panel -> colBegin; col < panel -> colEnd; col++)
+			{
+				fprintf(trace, "%d[%d]: [%d]x[%d] = %d\n", worker, pid, row, col, cRow[col]);
+			}
+		}
+	}
+	fflush(trace);
+}
+
+/**
+ * Read as much of the results of worker as is available without
+ * blocking.  In the pipe mode the tile of an accepted result goes
+ * straight into c, up to the end of one of its rows at a time.  The
+ * first result for a chunk is accepted; a later duplicate, or a stale
+ * result of an earlier call, is read and discarded.  Return -1 with
+ * errno set on error, EPIPE if the worker has died.
+ */
+static int
+readResults(Dispatch *d, int worker)
+{
+	struct MatrixMul *matMul = d -> matMul;
+	WorkerIo *io = &matMul -> io[worker];
+	_Bool shared = (matMul -> flags & MATRIX_MUL_SHARED_DATA) != 0;
+	int fd = matMul -> fileDescWorkersToParent[worker][0];
+	char scratch[4096];
+
+	while(1)
+	{
+		const Task *task = &io -> tasks[io -> head];
+		const MessageHeader *reply = &io -> inHeader;
+		char *buf = NULL;
+		size_t want = 0;
+		if(io -> inDone < sizeof(MessageHeader))
+		{
+			buf = (char *) &io -> inHeader + io -> inDone;
+			want = sizeof(MessageHeader) - io -> inDone;
+		}
+		else if(io -> inDone < sizeof(MessageHeader) + io -> inPayload)
+		{
+			size_t done = io -> inDone - sizeof(MessageHeader);
+			size_t rowBytes = (size_t) (reply -> colEnd - reply -> colBegin) * sizeof(MatrixBaseType);
+			if(io -> inDiscard)
+			{
+				buf = scratch;
+				want = io -> inPayload - done;
+				want = (want > sizeof(scratch)) ? sizeof(scratch) : want;
+			}
+			else
+			{
+				size_t row = reply -> rowBegin + done / rowBytes;
+				buf = (char *) (d -> c + row * d -> n3 + reply -> colBegin) + done % rowBytes;
+				want = rowBytes - done % rowBytes;
+			}
+		}
+
+		ssize_t n = (want > 0) ? read(fd, buf, want) : 0;
+		if(want > 0)
+		{
+			countIo(matMul -> ioCounters, n, false);
+		}
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+		}
+		if(n == 0 && want > 0)
+		{
+			errno = EPIPE;				// worker died
+			return -1;
+		}
+		size_t before = io -> inDone;
+		io -> inDone += n;
+
+		/**
+		 * Header just completed: it must describe the oldest task.
+		 * Accept it if it is the first result for a chunk of this call.
+		 */
+		if(before < sizeof(MessageHeader) && io -> inDone == sizeof(MessageHeader))
+		{
+			if(io -> nSent == 0 || reply -> type != (shared ? MSG_SHARED_DONE : MSG_RESULT) ||
+			   reply -> generation != task -> generation ||
+			   reply -> rowBegin != task -> rowBegin || reply -> rowEnd != task -> rowEnd ||
+			   reply -> colBegin != task -> colBegin || reply -> colEnd != task -> colEnd)
+			{
+				errno = EPROTO;			// out of step with worker
+				return -1;
+			}
+			io -> inPayload = shared ? 0 : (size_t) (reply -> rowEnd - reply -> rowBegin) *
+				(reply -> colEnd - reply -> colBegin) * sizeof(MatrixBaseType);
+			io -> inDiscard = true;
+			if(task -> generation == d -> generation && !matMul -> chunks[task -> chunk].claimed)
+			{
+				matMul -> chunks[task -> chunk].claimed = true;
+				io -> inDiscard = false;
+			}
+		}
+
+		if(io -> inDone == sizeof(MessageHeader) + io -> inPayload)
+		{
+			if(matMul -> traceFlag && drainTrace(d, worker, !io -> inDiscard) < 0)
+			{
+				return -1;
+			}
+			if(!io -> inDiscard)
+			{
+				d -> nDone++;
+			}
+			io -> head = (io -> head + 1) % TASK_RING;
+			io -> count--;
+			io -> nSent--;
+			io -> inDone = 0;
+		}
+	}
+}
+
+/**
+ * Wait for the results still owed by stragglers of earlier calls, and
+ * discard them.  Needed before the shared data region is rewritten,
+ * as a straggler computes from it and into it.  Return -1 with errno
+ * set on error, else 0.
+ */
+static int
+drainStale(Dispatch *d)
+{
+	struct MatrixMul *matMul = d -> matMul;
+	int nWorkers = matMul -> noOfWorkers;
+	struct pollfd fds[nWorkers];
+	while(1)
+	{
+		int nFds = 0;
+		for(int worker = 0; worker < nWorkers; worker++)
+		{
+			WorkerIo *io = &matMul -> io[worker];
+			if(io -> count > 0 || io -> inDone > 0)
+			{
+				fds[nFds++] = (struct pollfd) {
+					.fd = matMul -> fileDescWorkersToParent[worker][0], .events = POLLIN
+				};
+			}
+		}
+		if(nFds == 0)
+		{
+			return 0;
+		}
+		int nEvents = poll(fds, nFds, -1);
+		countIo(matMul -> ioCounters, 0, false);
+		if(nEvents < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		for(int worker = 0; worker < nWorkers; worker++)
+		{
+			WorkerIo *io = &matMul -> io[worker];
+			if((io -> count > 0 || io -> inDone > 0) && readResults(d, worker) < 0)
+			{
+				return -1;
+			}
+		}
+	}
+}
+
+/**
+ * Multiply with the worker processes of matMul.  On error it returns
+ * with *err set at once; mulMatrixMul() stops the hardware counters
+ * whichever way it returns.
+ */
+static void
+mulWorkers(struct MatrixMul *mutableMul, int n1, int n2, int n3,
+	   CONST MatrixBaseType a[n1][n2],
+	   CONST MatrixBaseType b[n2][n3],
+	   MatrixBaseType c[n1][n3], int *err)
+{
+	const MatrixMul *matMul = mutableMul;
+
+	int nWorkers = matMul -> noOfWorkers;
+	int minRows = guidedMinRows(n1, n2, nWorkers);
+
+	/**
+	 * Vertical panels of c, each computed by its own group of workers
+	 * which only need that panel of b
+	 */
+	_Bool shared = (matMul -> flags & MATRIX_MUL_SHARED_DATA) != 0;
+	int nPanels = (matMul -> flags & MATRIX_MUL_TILES) ? choosePanels(n1, n3, nWorkers) : 1;
+	Panel panels[nPanels];
+	if(!setupPanels(mutableMul, panels, nPanels, n2, n3, &b[0][0], !shared, err))
+	{
+		return;
+	}
+	Dispatch d = {
+		.matMul = mutableMul, .generation = ++mutableMul -> generation,
+		.n1 = n1, .n2 = n2, .n3 = n3, .a = &a[0][0], .c = &c[0][0],
+		.minRows = minRows, .nPanels = nPanels, .panels = panels,
+	};
+
+	/**
+	 * The multiplier is made available to every worker once: copied
+	 * into the shared region, once no straggler of an earlier call
+	 * uses it any more, or queued as the first message down every
+	 * task pipe
+	 */
+	if(shared && drainStale(&d) < 0)
+	{
+		*err = errno;
+		return;
+	}
+	if(shared && !prepareShared(mutableMul, n1, n2, n3, &a[0][0], &b[0][0], err))
+	{
+		return;
+	}
+
+	/**
+	 * Worker of every (row, panel) of the product, filled in from the
+	 * trace rings
+	 */
+	if(matMul -> traceFlag)
+	{
+		size_t nOwners = (size_t) n1 * nPanels;
+		if(nOwners > matMul -> traceOwnersCapacity)
+		{
+			int *owners = realloc(matMul -> traceOwners, nOwners * sizeof(int));
+			if(owners == NULL)
+			{
+				*err = ENOMEM;
+				return;
+			}
+			mutableMul -> traceOwners = owners;
+			mutableMul -> traceOwnersCapacity = nOwners;
+		}
+		memset(matMul -> traceOwners, -1, nOwners * sizeof(int));
+	}
+
+	/**
+	 * Every worker starts with TASK_DEPTH chunks, less what it still
+	 * owes from earlier calls, dealt out one round at a time so the
+	 * large early chunks are spread over all workers
+	 */
+	WorkerIo *io = matMul -> io;
+	for(int worker = 0; worker < nWorkers; worker++)
+	{
+		io[worker].sendB = !shared;
+		io[worker].wanted = 0;
+	}
+	for(int depth = 0; depth < TASK_DEPTH; depth++)
+	{
+		for(int worker = 0; worker < nWorkers; worker++)
+		{
+			if(io[worker].count < TASK_DEPTH && assignChunk(&d, worker) < 0)
+			{
+				*err = errno;
+				return;
+			}
+		}
+	}
+
+	/**
+	 * Event loop.  Pull-based dispatch: whichever worker announces
+	 * itself on the ready channel is given the next chunk, so fast
+	 * workers take more of the rows and a slow one only holds up its
+	 * last (small) chunk.  With MATRIX_MUL_SPECULATE, a worker left
+	 * idle once all rows are handed out gets a duplicate of a chunk
+	 * still outstanding elsewhere, and the first result wins, so a
+	 * preempted worker does not hold up the call at all.  Writes of
+	 * chunks and reads of results are interleaved over all workers on
+	 * nonblocking pipes, so at most TASK_RING chunks per worker are in
+	 * flight whatever the size of the matrices.
+	 *
+	 * Once every chunk has a result, chunks not yet sent are dropped
+	 * and the loop only finishes the messages partly transferred, so
+	 * the pipes are left at message boundaries.  Results still owed
+	 * by stragglers are discarded by later calls, recognized by the
+	 * generation of their task.
+	 */
+	struct pollfd fds[1 + 2 * nWorkers];
+	while(1)
+	{
+		if(d.nDone == d.nChunks)
+		{
+			_Bool allAssigned = true;
+			for(int i = 0; i < nPanels; i++)
+			{
+				allAssigned = allAssigned && panels[i].nextRow >= n1;
+			}
+			_Bool partial = false;
+			for(int worker = 0; allAssigned && worker < nWorkers; worker++)
+			{
+				io[worker].count = io[worker].nSent;	// drop unsent chunks
+				io[worker].sendB = false;
+				io[worker].wanted = 0;
+				partial = partial || hasPartialMessage(&io[worker]);
+			}
+			if(allAssigned && !partial)
+			{
+				break;
+			}
+		}
+
+		fds[0] = (struct pollfd) { .fd = matMul -> readyPipe[0], .events = POLLIN };
+		for(int worker = 0; worker < nWorkers; worker++)
+		{
+			fds[1 + 2 * worker] = (struct pollfd) {
+				.fd = matMul -> fileDescWorkersToParent[worker][0], .events = POLLIN
+			};
+			fds[2 + 2 * worker] = (struct pollfd) {
+				.fd = hasPendingTasks(&io[worker]) ? matMul -> fileDescParentToWorkers[worker][1] : -1,
+				.events = POLLOUT
+			};
+		}
+		int nEvents = poll(fds, 1 + 2 * nWorkers, -1);
+		countIo(matMul -> ioCounters, 0, false);
+		if(nEvents < 0)
+		{
+			if(errno == EINTR) continue;
+			*err = errno;
+			return;
+		}
+
+		/**
+		 * Ready announcements.  Every write to the channel is a
+		 * single int written atomically, so a read of a multiple of
+		 * sizeof(int) bytes only ever returns whole announcements.
+		 * One left over from an earlier call still means its worker
+		 * is about to free a slot of its ring.
+		 */
+		if(fds[0].revents != 0)
+		{
+			int ready[64];
+			ssize_t n = read(matMul -> readyPipe[0], ready, sizeof(ready));
+			countIo(matMul -> ioCounters, n, false);
+			if(n == 0)
+			{
+				*err = EPIPE;				// all workers gone
+				return;
+			}
+			if(n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				*err = errno;
+				return;
+			}
+			for(int i = 0; i < n / (ssize_t) sizeof(int); i++)
+			{
+				int worker = ready[i];
+				if(worker < 0 || worker >= nWorkers)
+				{
+					*err = EPROTO;
+					return;
+				}
+				io[worker].wanted++;
+				if(answerReady(&d, worker) < 0)
+				{
+					*err = errno;
+					return;
+				}
+			}
+		}
+
+		for(int worker = 0; worker < nWorkers; worker++)
+		{
+			if(fds[1 + 2 * worker].revents != 0)
+			{
+				if(readResults(&d, worker) < 0 || answerReady(&d, worker) < 0)
+				{
+					*err = errno;
+					return;
+				}
+			}
+			if(fds[2 + 2 * worker].revents != 0 && writeTasks(&d, worker) < 0)
+			{
+				*err = errno;
+				return;
+			}
+		}
+	}
+
+	if(matMul -> flags & MATRIX_MUL_SHARED_DATA)
+	{
+		memcpy(c, matMul -> shared + (size_t) n1 * n2 + (size_t) n2 * n3,
+		       (size_t) n1 * n3 * sizeof(MatrixBaseType));
+	}
+
+	if(matMul -> traceFlag)
+	{
+		writeTrace(&d);
+	}
+	mutableMul -> reusable = true;
+
+	// Done Multi-process Matrix Multiplier with Client and Worker processes
+}
+
+/** Set matrix c[n1][n3] to a[n1][n2] * b[n2][n3].  It is assumed that
+ *  the caller has allocated c[][] appropriately.  Set *err to an
+ *  appropriate error number (documented in errno(3)) on error.  If
+ *  *err is returned as non-zero, then the matMul object may no longer
+ *  be valid and future calls to mulMatrixMul() may have unpredictable
+ *  behavior.  It is the responsibility of the caller to call
+ *  freeMatrixMul() after an error.
+ *
+ *  All dot-products of rows from a[][] and columns from b[][] must be
+ *  performed using the worker processes which were already created in
+ *  newMatrixMul() and all IPC must be handled using anonymous pipes.
+ *  The multiplication should be set up in such a way so as to allow
+ *  the worker processes to work on different dot-products
+ *  concurrently.
+ */
+void
+mulMatrixMul(const MatrixMul *matMul, int n1, int n2, int n3,
+             CONST MatrixBaseType a[n1][n2],
+             CONST MatrixBaseType b[n2][n3],
+             MatrixBaseType c[n1][n3], int *err)
+{
+	if(matMul -> perfFlag)
+	{
+		startPerf(matMul);
+	}
+
+	/**
+	 * Cleared by any failure on the way
+	 */
+	struct MatrixMul *mutableMul = (struct MatrixMul *) matMul;
+	mutableMul -> reusable = false;
+
+	if(matMul -> threads != NULL)
+	{
+		mulMatrixMulThreads(matMul -> threads, n1, n2, n3, &a[0][0], &b[0][0], &c[0][0], matMul -> trace, err);
+		mutableMul -> reusable = (*err == 0);
+	}
+	else
+	{
+		mulWorkers(mutableMul, n1, n2, n3, a, b, c, err);
+	}
+
+	if(matMul -> perfFlag)
+	{
+		stopPerf(matMul, n1, n2, n3);
+	}
+}
+
+/**
+ * Process-wide warm pool: multipliers freed with MATRIX_MUL_WARM_POOL,
+ * most recently parked first.  A reaper thread, running while the pool
+ * is not empty, stops those parked for longer than their idleMs.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t parked;		// a multiplier was parked
+	struct MatrixMul *idle;
+	_Bool reaping;			// reaper thread running
+} warmPool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, false };
+
+/**
+ * Take a parked multiplier of nWorkers and the same configuration out
+ * of the warm pool; return NULL if there is none.
+ */
+static struct MatrixMul *
+leaseWarm(int nWorkers, unsigned flags, _Bool traceFlag, _Bool perfFlag)
+{
+	pthread_mutex_lock(&warmPool.lock);
+	struct MatrixMul **link = &warmPool.idle;
+	while(*link != NULL && ((*link) -> noOfWorkers != nWorkers || (*link) -> flags != flags ||
+				(*link) -> traceFlag != traceFlag || (*link) -> perfFlag != perfFlag))
+	{
+		link = &(*link) -> nextIdle;
+	}
+	struct MatrixMul *matMul = *link;
+	if(matMul != NULL)
+	{
+		*link = matMul -> nextIdle;
+		matMul -> nextIdle = NULL;
+	}
+	pthread_mutex_unlock(&warmPool.lock);
+	return matMul;
+}
+
+/**
+ * Reaper thread: stop the parked multipliers whose idle time is up,
+ * sleeping until the next one is due; exit once the pool is empty.
+ */
+static void *
+reapWarm(void *arg)
+{
+	(void) arg;
+	pthread_mutex_lock(&warmPool.lock);
+	while(warmPool.idle != NULL)
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		struct MatrixMul *expired = NULL;
+		struct timespec next = { 0, 0 };
+		struct MatrixMul **link = &warmPool.idle;
+		while(*link != NULL)
+		{
+			struct MatrixMul *matMul = *link;
+			struct timespec due = matMul -> idleSince;
+			due.tv_sec += matMul -> idleMs / 1000;
+			due.tv_nsec += (long) (matMul -> idleMs % 1000) * 1000000;
+			if(due.tv_nsec >= 1000000000)
+			{
+				due.tv_sec++;
+				due.tv_nsec -= 1000000000;
+			}
+			if(due.tv_sec < now.tv_sec || (due.tv_sec == now.tv_sec && due.tv_nsec <= now.tv_nsec))
+			{
+				*link = matMul -> nextIdle;
+				matMul -> nextIdle = expired;
+				expired = matMul;
+				continue;
+			}
+			if((next.tv_sec == 0 && next.tv_nsec == 0) || due.tv_sec < next.tv_sec ||
+			   (due.tv_sec == next.tv_sec && due.tv_nsec < next.tv_nsec))
+			{
+				next = due;
+			}
+			link = &matMul -> nextIdle;
+		}
+
+		if(expired != NULL)
+		{
+			pthread_mutex_unlock(&warmPool.lock);
+			while(expired != NULL)
+			{
+				struct MatrixMul *matMul = expired;
+				expired = matMul -> nextIdle;
+				destroyMatrixMul(matMul);
+			}
+			pthread_mutex_lock(&warmPool.lock);
+		}
+		else
+		{
+			pthread_cond_timedwait(&warmPool.parked, &warmPool.lock, &next);
+		}
+	}
+	warmPool.reaping = false;
+	pthread_mutex_unlock(&warmPool.lock);
+	return NULL;
+}
+
+/**
+ * Park matMul in the warm pool instead of stopping its workers.  Its
+ * workers first finish any results still owed from speculative
+ * re-dispatch, which are discarded.  Return false if matMul cannot be
+ * reused or parked, and is to be destroyed.
+ */
+static _Bool
+parkWarm(struct MatrixMul *matMul)
+{
+	if(!matMul -> reusable || matMul -> idleMs == 0)
+	{
+		return false;
+	}
+	if(matMul -> threads == NULL)
+	{
+		Panel panel = { 0 };
+		Dispatch d = {
+			.matMul = matMul, .generation = ++matMul -> generation,
+			.nPanels = 1, .panels = &panel,
+		};
+		if(drainStale(&d) < 0)
+		{
+			return false;
+		}
+	}
+
+	pthread_mutex_lock(&warmPool.lock);
+	_Bool parked = true;
+	if(!warmPool.reaping)
+	{
+		pthread_t reaper;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		warmPool.reaping = parked = (pthread_create(&reaper, &attr, reapWarm, NULL) == 0);
+		pthread_attr_destroy(&attr);
+	}
+	if(parked)
+	{
+		clock_gettime(CLOCK_REALTIME, &matMul -> idleSince);
+		matMul -> nextIdle = warmPool.idle;
+		warmPool.idle = matMul;
+		pthread_cond_signal(&warmPool.parked);
+	}
+	pthread_mutex_unlock(&warmPool.lock);
+	return parked;
+}
+
+/**
+ * Sum the I/O counters of the client and of every worker.
+ */
+void
+getMatrixMulStats(const MatrixMul *matMul, MatrixMulStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if(matMul -> ioCounters == NULL)
+	{
+		return;				// thread backend: no pipes
+	}
+	for(int i = 0; i <= matMul -> noOfWorkers; i++)
+	{
+		const IoCounters *counters = &matMul -> ioCounters[i];
+		unsigned long long syscalls = __atomic_load_n(&counters -> syscalls, __ATOMIC_RELAXED);
+		unsigned long long bytesOut = __atomic_load_n(&counters -> bytesOut, __ATOMIC_RELAXED);
+		if(i == 0)
+		{
+			stats -> clientSyscalls = syscalls;
+			stats -> bytesToWorkers = bytesOut;
+		}
+		else
+		{
+			stats -> workerSyscalls += syscalls;
+			stats -> bytesFromWorkers += bytesOut;
+		}
+	}
 }
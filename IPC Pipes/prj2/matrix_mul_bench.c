@@ -0,0 +1,304 @@
+/**
+ * Scaling benchmark for the MatrixMul worker pool.  For every shape of
+ * the sweep it times mulMatrixMul() with 1, 2, 4, ... workers and
+ * reports the median wall time, the speedup and efficiency relative to
+ * one worker, and the system calls issued and bytes pushed through the
+ * pipes per multiply, taken from the pool's own counters (see
+ * getMatrixMulStats() in matrix_mul_options.h).
+ *
+ * usage: matrix_mul_bench [--warmup N] [--reps N] [--max-size N]
+ *                         [--max-workers N] [--csv FILE] [--json FILE]
+ *
+ * The pool is constructed with the options of MATRIX_MUL_OPTIONS, so
+ * IPC protocols are compared by running the benchmark once per
+ * setting, e.g. MATRIX_MUL_OPTIONS=shared-data,zero-copy; the options
+ * are recorded with the results.  The CSV and JSON files hold one
+ * record per (shape, workers) so that runs can be diffed directly.
+ * When the one-worker run of a shape fails there is no baseline: its
+ * speedup and efficiency are printed as "-", left empty in the CSV
+ * file and null in the JSON file.
+ */
+
+#include "matrix_mul.h"
+#include "matrix_mul_options.h"
+#include "perf_counters.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Default number of untimed and timed runs per measurement
+ */
+#define DEFAULT_WARMUP 1
+#define DEFAULT_REPS 5
+
+/**
+ * Default largest dimension in the sweep and largest pool
+ */
+#define DEFAULT_MAX_SIZE 4096
+#define DEFAULT_MAX_WORKERS 8
+
+/** A benchmarked shape: a[n1][n2] * b[n2][n3]. */
+typedef struct {
+	const char *kind;			// shape family
+	int n1, n2, n3;				// dimensions
+} BenchShape;
+
+/** Measurements of one (shape, workers). */
+typedef struct {
+	double medianNs;			// median time per multiply
+	double p95Ns;				// 95th percentile time per multiply
+	double syscalls;			// client and worker syscalls per multiply
+	double clientSyscalls;			// client syscalls per multiply
+	double pipeBytes;			// bytes through the pipes per multiply
+} BenchResult;
+
+/**
+ * The shape sweep.  Shapes with a dimension above --max-size are skipped.
+ */
+static const BenchShape benchShapes[] = {
+	{ "square", 64, 64, 64 },
+	{ "square", 128, 128, 128 },
+	{ "square", 256, 256, 256 },
+	{ "square", 512, 512, 512 },
+	{ "square", 1024, 1024, 1024 },
+	{ "tall-skinny", 4096, 64, 64 },
+	{ "fat", 64, 64, 4096 },
+	{ "deep", 64, 4096, 64 },
+};
+
+#define N_SHAPES ((int) (sizeof(benchShapes) / sizeof(benchShapes[0])))
+
+/**
+   Benchmark shape with a pool of nWorkers; return 0 on success or an
+   errno.
+*/
+static int benchOne(const BenchShape *shape, int nWorkers, int warmup, int reps, BenchResult *result)
+{
+	int n1 = shape -> n1, n2 = shape -> n2, n3 = shape -> n3;
+	int err = 0;
+	MatrixBaseType (*a)[n2] = malloc(sizeof(MatrixBaseType) * n1 * n2);
+	MatrixBaseType (*b)[n3] = malloc(sizeof(MatrixBaseType) * n2 * n3);
+	MatrixBaseType (*c)[n3] = malloc(sizeof(MatrixBaseType) * n1 * n3);
+	MatrixMul *matMul = NULL;
+	if(a == NULL || b == NULL || c == NULL)
+	{
+		err = ENOMEM;
+	}
+	else
+	{
+		matMul = newMatrixMul(nWorkers, NULL, &err);
+	}
+
+	if(matMul != NULL)
+	{
+		for(int i = 0; i < n1; i++)
+			for(int k = 0; k < n2; k++)
+				a[i][k] = rand() % 21 - 10;
+		for(int k = 0; k < n2; k++)
+			for(int j = 0; j < n3; j++)
+				b[k][j] = rand() % 21 - 10;
+
+		double samples[reps];
+		MatrixMulStats before, after;
+		for(int run = 0; run < warmup + reps && err == 0; run++)
+		{
+			if(run == warmup)
+			{
+				getMatrixMulStats(matMul, &before);
+			}
+			double start = perfNowNs();
+			mulMatrixMul(matMul, n1, n2, n3, (CONST MatrixBaseType (*)[n2]) a,
+				     (CONST MatrixBaseType (*)[n3]) b, c, &err);
+			if(run >= warmup)
+			{
+				samples[run - warmup] = perfNowNs() - start;
+			}
+		}
+		getMatrixMulStats(matMul, &after);
+
+		if(err == 0)
+		{
+			sortPerfTimes(samples, reps);
+			result -> medianNs = perfTimeQuantile(samples, reps, 0.5);
+			result -> p95Ns = perfTimeQuantile(samples, reps, 0.95);
+			result -> clientSyscalls = (double) (after.clientSyscalls - before.clientSyscalls) / reps;
+			result -> syscalls = result -> clientSyscalls +
+				(double) (after.workerSyscalls - before.workerSyscalls) / reps;
+			result -> pipeBytes = (double) (after.bytesToWorkers - before.bytesToWorkers +
+							after.bytesFromWorkers - before.bytesFromWorkers) / reps;
+		}
+
+		int freeErr = 0;
+		freeMatrixMul(matMul, &freeErr);
+	}
+
+	free(a);
+	free(b);
+	free(c);
+	return err;
+}
+
+/**
+   Worker counts of the sweep: powers of two up to maxWorkers, and
+   maxWorkers itself.  Return the one after nWorkers.
+*/
+static int nextWorkers(int nWorkers, int maxWorkers)
+{
+	if(nWorkers < maxWorkers && nWorkers * 2 > maxWorkers)
+	{
+		return maxWorkers;
+	}
+	return nWorkers * 2;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [--warmup N] [--reps N] [--max-size N] "
+		"[--max-workers N] [--csv FILE] [--json FILE]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+/**
+   Format value into buf with format and return buf, or return missing
+   if value is NaN.
+*/
+static const char *formatRatio(char *buf, size_t size, const char *format, double value, const char *missing)
+{
+	if(isnan(value))
+	{
+		return missing;
+	}
+	snprintf(buf, size, format, value);
+	return buf;
+}
+
+/**
+   Open path for writing or exit.
+*/
+static FILE *openOutput(const char *prog, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if(file == NULL)
+	{
+		fprintf(stderr, "%s: cannot open %s: %s\n", prog, path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return file;
+}
+
+int main(int argc, const char *argv[])
+{
+	int warmup = DEFAULT_WARMUP, reps = DEFAULT_REPS;
+	int maxSize = DEFAULT_MAX_SIZE, maxWorkers = DEFAULT_MAX_WORKERS;
+	const char *csvPath = NULL, *jsonPath = NULL;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(i + 1 >= argc) usage(argv[0]);
+		if(strcmp(argv[i], "--warmup") == 0) warmup = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--reps") == 0) reps = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-size") == 0) maxSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-workers") == 0) maxWorkers = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--csv") == 0) csvPath = argv[++i];
+		else if(strcmp(argv[i], "--json") == 0) jsonPath = argv[++i];
+		else usage(argv[0]);
+	}
+	if(warmup < 0 || reps < 1 || maxSize < 1 || maxWorkers < 1) usage(argv[0]);
+
+	const char *options = getenv("MATRIX_MUL_OPTIONS");
+	options = (options != NULL) ? options : "";
+	FILE *csv = (csvPath != NULL) ? openOutput(argv[0], csvPath) : NULL;
+	FILE *json = (jsonPath != NULL) ? openOutput(argv[0], jsonPath) : NULL;
+	if(csv != NULL)
+	{
+		fprintf(csv, "options,shape,n1,n2,n3,workers,median_ns,p95_ns,speedup,efficiency,"
+			"syscalls_per_mul,client_syscalls_per_mul,pipe_bytes_per_mul\n");
+	}
+	if(json != NULL)
+	{
+		fprintf(json, "{\n  \"options\": \"%s\",\n  \"warmup\": %d,\n  \"reps\": %d,\n  \"results\": [",
+			options, warmup, reps);
+	}
+
+	printf("%-11s %-16s %7s %14s %14s %8s %6s %12s %14s\n",
+	       "shape", "dims", "workers", "median ns", "p95 ns", "speedup", "eff", "syscalls/mul", "pipe bytes/mul");
+
+	int nRecords = 0;
+	for(int s = 0; s < N_SHAPES; s++)
+	{
+		const BenchShape *shape = &benchShapes[s];
+		if(shape -> n1 > maxSize || shape -> n2 > maxSize || shape -> n3 > maxSize)
+		{
+			continue;
+		}
+		char dims[32];
+		snprintf(dims, sizeof(dims), "%dx%dx%d", shape -> n1, shape -> n2, shape -> n3);
+
+		double baseNs = 0;
+		for(int nWorkers = 1; nWorkers <= maxWorkers; nWorkers = nextWorkers(nWorkers, maxWorkers))
+		{
+			BenchResult result = { 0 };
+			int err = benchOne(shape, nWorkers, warmup, reps, &result);
+			if(err != 0)
+			{
+				fprintf(stderr, "%s %d workers: %s\n", dims, nWorkers, strerror(err));
+				if(nWorkers == 1)
+				{
+					fprintf(stderr, "%s: no 1-worker baseline, speedup and efficiency not reported\n", dims);
+				}
+				continue;
+			}
+			if(nWorkers == 1)
+			{
+				baseNs = result.medianNs;
+			}
+			double speedup = (baseNs > 0) ? baseNs / result.medianNs : NAN;
+			double efficiency = speedup / nWorkers;
+			char speedupText[32], efficiencyText[32];
+
+			printf("%-11s %-16s %7d %14.0f %14.0f %8s %6s %12.1f %14.0f\n",
+			       shape -> kind, dims, nWorkers, result.medianNs, result.p95Ns,
+			       formatRatio(speedupText, sizeof(speedupText), "%.2f", speedup, "-"),
+			       formatRatio(efficiencyText, sizeof(efficiencyText), "%.2f", efficiency, "-"),
+			       result.syscalls, result.pipeBytes);
+			fflush(stdout);
+
+			if(csv != NULL)
+			{
+				fprintf(csv, "\"%s\",%s,%d,%d,%d,%d,%.0f,%.0f,%s,%s,%.1f,%.1f,%.0f\n",
+					options, shape -> kind, shape -> n1, shape -> n2, shape -> n3, nWorkers,
+					result.medianNs, result.p95Ns,
+					formatRatio(speedupText, sizeof(speedupText), "%.4f", speedup, ""),
+					formatRatio(efficiencyText, sizeof(efficiencyText), "%.4f", efficiency, ""),
+					result.syscalls, result.clientSyscalls, result.pipeBytes);
+			}
+			if(json != NULL)
+			{
+				fprintf(json, "%s\n    {\"shape\": \"%s\", \"n1\": %d, \"n2\": %d, \"n3\": %d, "
+					"\"workers\": %d, \"median_ns\": %.0f, \"p95_ns\": %.0f, "
+					"\"speedup\": %s, \"efficiency\": %s, \"syscalls_per_mul\": %.1f, "
+					"\"client_syscalls_per_mul\": %.1f, \"pipe_bytes_per_mul\": %.0f}",
+					(nRecords++ > 0) ? "," : "", shape -> kind, shape -> n1, shape -> n2, shape -> n3,
+					nWorkers, result.medianNs, result.p95Ns,
+					formatRatio(speedupText, sizeof(speedupText), "%.4f", speedup, "null"),
+					formatRatio(efficiencyText, sizeof(efficiencyText), "%.4f", efficiency, "null"),
+					result.syscalls, result.clientSyscalls, result.pipeBytes);
+			}
+		}
+	}
+
+	if(csv != NULL)
+	{
+		fclose(csv);
+	}
+	if(json != NULL)
+	{
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef _MATRIX_MUL_OPTIONS_H
+#define _MATRIX_MUL_OPTIONS_H
+
+#include "matrix_mul.h"
+
+/** Flags selecting how a MatrixMul moves data between the client and
+ *  its workers, and where they run.
+ */
+enum {
+
+  /** Keep a, b and c in a shared memory region which the workers
+   *  inherit at fork time; the pipes then only carry small control
+   *  messages (row ranges and completions).
+   */
+  MATRIX_MUL_SHARED_DATA = 0x1,
+
+  /** Splice large row blocks into the pipes with vmsplice(2) instead
+   *  of copying them, in pipe buffers enlarged with F_SETPIPE_SZ.
+   *  Ignored, falling back to copies, where vmsplice() is unsupported.
+   */
+  MATRIX_MUL_ZERO_COPY = 0x2,
+
+  /** Partition c into 2-D tiles: the workers form groups, one per
+   *  vertical panel of c, sized from the number of workers and the
+   *  shape of the product, and each worker receives only its panel of
+   *  b and the rows of a of the chunks it computes.
+   */
+  MATRIX_MUL_TILES = 0x4,
+
+  /** Pin each worker to a distinct CPU of those the client may run on
+   *  (sched_getaffinity(2)), wrapping around if there are more workers
+   *  than CPUs.
+   */
+  MATRIX_MUL_PIN_WORKERS = 0x8,
+
+  /** Pin the client to the first of its CPUs for the life of the
+   *  MatrixMul and keep the workers, and the default worker count, off
+   *  it.  Its previous affinity is restored by freeMatrixMul().  No
+   *  effect if the client may only run on one CPU.
+   */
+  MATRIX_MUL_PIN_PARENT = 0x10,
+
+  /** Once every row has been handed out, give an idle worker a copy of
+   *  a chunk still outstanding at another worker of its group and use
+   *  whichever result arrives first, so a preempted or slow worker does
+   *  not hold up the multiplication.  The late result is discarded,
+   *  possibly by a later call.
+   */
+  MATRIX_MUL_SPECULATE = 0x20,
+
+  /** Use a pool of threads in the client process instead of worker
+   *  processes and pipes, with the same trace lines (the pid field
+   *  holds the thread id).  Faster for moderate sizes, without the
+   *  isolation of processes; MATRIX_MUL_PIN_WORKERS and
+   *  MATRIX_MUL_PIN_PARENT apply, the data movement flags are ignored.
+   */
+  MATRIX_MUL_THREADS = 0x40,
+
+  /** freeMatrixMul() parks the multiplier, its workers still running,
+   *  in a process-wide warm pool instead of stopping them, and
+   *  newMatrixMulWithOptions() takes a parked one of the same worker
+   *  count, flags and tracing/perf setting when there is one, which
+   *  costs microseconds instead of forking.  A parked multiplier is
+   *  destroyed once it has been idle for idleMs.
+   */
+  MATRIX_MUL_WARM_POOL = 0x80,
+
+};
+
+/** Construction options of a MatrixMul. */
+typedef struct MatrixMulOptions {
+  unsigned flags;               //MATRIX_MUL_* flags
+  unsigned idleMs;              //idle timeout in the warm pool, 0 to never park
+} MatrixMulOptions;
+
+/** Set *options to the defaults used by newMatrixMul().  The
+ *  MATRIX_MUL_OPTIONS environment variable may hold a comma separated
+ *  list of flag names which are turned on:
+ *
+ *    shared-data       MATRIX_MUL_SHARED_DATA
+ *    zero-copy         MATRIX_MUL_ZERO_COPY
+ *    tiles             MATRIX_MUL_TILES
+ *    pin               MATRIX_MUL_PIN_WORKERS
+ *    pin-parent        MATRIX_MUL_PIN_PARENT
+ *    speculate         MATRIX_MUL_SPECULATE
+ *    threads           MATRIX_MUL_THREADS
+ *    warm-pool         MATRIX_MUL_WARM_POOL
+ *
+ *  idleMs is read from MATRIX_MUL_IDLE_MS, 5000 by default.
+ */
+void initMatrixMulOptions(MatrixMulOptions *options);
+
+/** As newMatrixMul() but constructed with *options; if options is NULL
+ *  the defaults of initMatrixMulOptions() are used.  nWorkers may be 0
+ *  for one worker per CPU the client may run on (less the client's own
+ *  with MATRIX_MUL_PIN_PARENT).
+ */
+MatrixMul *newMatrixMulWithOptions(int nWorkers, FILE *trace,
+                                   const MatrixMulOptions *options, int *err);
+
+/** I/O accounting of a MatrixMul since its construction.  Only the
+ *  pipes and the ready channel are counted; a shared data region or the
+ *  thread backend moves data without them.  The counts of the workers
+ *  may lag behind by the system calls in progress when read.
+ */
+typedef struct MatrixMulStats {
+  unsigned long long clientSyscalls;    //reads, writes and polls of the client
+  unsigned long long workerSyscalls;    //reads and writes of all workers
+  unsigned long long bytesToWorkers;    //bytes written into the task pipes
+  unsigned long long bytesFromWorkers;  //bytes written into the result and ready pipes
+} MatrixMulStats;
+
+/** Set *stats to the I/O accounting of matMul. */
+void getMatrixMulStats(const MatrixMul *matMul, MatrixMulStats *stats);
+
+#endif //ifndef _MATRIX_MUL_OPTIONS_H
@@ -0,0 +1,55 @@
+#include "matrix_mul_sched.h"
+
+/**
+ * Smallest guided chunk of a[n1][n2] among nWorkers: about TASK_BYTES
+ * of the multiplicand, but small enough that every worker gets several
+ * chunks.
+ */
+int
+guidedMinRows(int n1, int n2, int nWorkers)
+{
+	int minRows = TASK_BYTES / ((n2 > 0 ? n2 : 1) * (int) sizeof(MatrixBaseType));
+	int rowsPerWorker = n1 / (GUIDED_FACTOR * GUIDED_FACTOR * nWorkers);
+	minRows = (minRows > rowsPerWorker) ? rowsPerWorker : minRows;
+	return (minRows < 1) ? 1 : minRows;
+}
+
+/**
+ * Size of the next guided chunk when remaining rows are left.
+ */
+int
+guidedChunk(int remaining, int nWorkers, int minRows)
+{
+	int rows = (remaining + GUIDED_FACTOR * nWorkers - 1) / (GUIDED_FACTOR * nWorkers);
+	rows = (rows < minRows) ? minRows : rows;
+	return (rows > remaining) ? remaining : rows;
+}
+
+/**
+ * Set the tile c[nRows][nCols] to a[nRows][n2] * b[n2][nCols], where
+ * consecutive rows of a, b and c are lda, ldb and ldc elements apart;
+ * k runs outside j so b is walked along its rows.
+ */
+void
+computeRows(const MatrixBaseType *a, size_t lda, const MatrixBaseType *b, size_t ldb,
+	    MatrixBaseType *c, size_t ldc, int nRows, int n2, int nCols)
+{
+	for(int i = 0; i < nRows; i++)
+	{
+		const MatrixBaseType *aRow = a + i * lda;
+		MatrixBaseType *cRow = c + i * ldc;
+		for(int j = 0; j < nCols; j++)
+		{
+			cRow[j] = 0;
+		}
+		for(int k = 0; k < n2; k++)
+		{
+			MatrixBaseType multiplicandElement = aRow[k];
+			const MatrixBaseType *bRow = b + k * ldb;
+			for(int j = 0; j < nCols; j++)
+			{
+				cRow[j] += multiplicandElement * bRow[j];
+			}
+		}
+	}
+}
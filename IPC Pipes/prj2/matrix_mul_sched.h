@@ -0,0 +1,41 @@
+#ifndef _MATRIX_MUL_SCHED_H
+#define _MATRIX_MUL_SCHED_H
+
+#include "matrix_mul.h"
+
+#include <stddef.h>
+
+/** Internal to the MatrixMul backends: how rows of the multiplicand
+ *  are handed out to the workers of the process and thread backends,
+ *  and the kernel both of them run on their rows.
+ */
+
+/** Smallest payload of a task.  Rows of the multiplicand are handed
+ *  out in guided chunks, starting large and shrinking as the remaining
+ *  rows run out, but never below about this many bytes, so the number
+ *  of tasks stays O(n1 * n2 / TASK_BYTES) at most.
+ */
+ #define TASK_BYTES (32 * 1024)
+
+/** Guided self-scheduling: a chunk is the remaining rows divided by
+ *  GUIDED_FACTOR * nWorkers, so the last chunks are small enough for
+ *  the fastest workers to absorb the imbalance of the slow ones.
+ */
+ #define GUIDED_FACTOR 2
+
+/** Smallest guided chunk of a[n1][n2] among nWorkers, at least 1. */
+int guidedMinRows(int n1, int n2, int nWorkers);
+
+/** Size of the next guided chunk among nWorkers when remaining rows
+ *  are left, no smaller than minRows unless fewer rows remain.
+ */
+int guidedChunk(int remaining, int nWorkers, int minRows);
+
+/** Set the tile c[nRows][nCols] to a[nRows][n2] * b[n2][nCols], where
+ *  consecutive rows of a, b and c are lda, ldb and ldc elements apart.
+ */
+void computeRows(const MatrixBaseType *a, size_t lda,
+                 const MatrixBaseType *b, size_t ldb,
+                 MatrixBaseType *c, size_t ldc, int nRows, int n2, int nCols);
+
+#endif //ifndef _MATRIX_MUL_SCHED_H
@@ -0,0 +1,289 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE			// pthread_setaffinity_np()
+#endif
+
+#include "matrix_mul_threads.h"
+#include "matrix_mul_sched.h"
+
+#include "errors.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/**
+ * The pool.  Every multiplication is a new generation of work: the
+ * client publishes the operands under the lock, bumps generation and
+ * wakes the threads, which take chunks of rows until none are left and
+ * then report on done.
+ */
+struct MatrixMulThreads {
+
+     int nThreads;
+     pthread_t *threads;
+     pid_t *tids;		// kernel thread ids, for the trace lines
+
+     pthread_mutex_t lock;
+     pthread_cond_t start;	// a new generation or stop
+     pthread_cond_t done;	// running dropped to 0
+     unsigned generation;
+     int running;		// threads still busy with the current generation
+     _Bool stop;
+
+     /*
+      * Current multiplication, and the first row not yet handed out
+      */
+     int n1, n2, n3;
+     FILE *trace;		// trace output of the call, NULL for none
+     const MatrixBaseType *a;
+     const MatrixBaseType *b;
+     MatrixBaseType *c;
+     int nextRow;
+     int minRows;
+
+     /*
+      * When tracing, the thread which computed each row of c
+      */
+     int *owners;
+     size_t ownersCapacity;
+
+};
+
+/**
+ * Arguments of a thread
+ */
+typedef struct ThreadStart {
+     MatrixMulThreads *pool;
+     int index;
+} ThreadStart;
+
+/**
+ * Take the next chunk of rows of the current multiplication into
+ * [*rowBegin, *rowEnd).  Return false if none are left.  Called with
+ * the lock held.
+ */
+static _Bool
+takeChunk(MatrixMulThreads *pool, int *rowBegin, int *rowEnd)
+{
+	int remaining = pool -> n1 - pool -> nextRow;
+	if(remaining <= 0)
+	{
+		return false;
+	}
+	int rows = guidedChunk(remaining, pool -> nThreads, pool -> minRows);
+	*rowBegin = pool -> nextRow;
+	pool -> nextRow += rows;
+	*rowEnd = pool -> nextRow;
+	return true;
+}
+
+/**
+ * Thread main loop: wait for a generation, compute chunks of it until
+ * none are left, report, repeat until stopped.
+ */
+static void *
+runThread(void *arg)
+{
+	ThreadStart start = *(ThreadStart *) arg;
+	free(arg);
+	MatrixMulThreads *pool = start.pool;
+	pool -> tids[start.index] = (pid_t) syscall(SYS_gettid);
+
+	unsigned seen = 0;
+	pthread_mutex_lock(&pool -> lock);
+	while(1)
+	{
+		while(pool -> generation == seen && !pool -> stop)
+		{
+			pthread_cond_wait(&pool -> start, &pool -> lock);
+		}
+		if(pool -> stop)
+		{
+			break;
+		}
+		seen = pool -> generation;
+
+		int rowBegin, rowEnd;
+		while(takeChunk(pool, &rowBegin, &rowEnd))
+		{
+			pthread_mutex_unlock(&pool -> lock);
+			int n2 = pool -> n2, n3 = pool -> n3;
+			computeRows(pool -> a + (size_t) rowBegin * n2, n2, pool -> b, n3,
+				    pool -> c + (size_t) rowBegin * n3, n3, rowEnd - rowBegin, n2, n3);
+			if(pool -> trace != NULL)
+			{
+				for(int row = rowBegin; row < rowEnd; row++)
+				{
+					pool -> owners[row] = start.index;
+				}
+			}
+			pthread_mutex_lock(&pool -> lock);
+		}
+
+		if(--pool -> running == 0)
+		{
+			pthread_cond_signal(&pool -> done);
+		}
+	}
+	pthread_mutex_unlock(&pool -> lock);
+	return NULL;
+}
+
+/**
+ * Stop the first nStarted threads of pool, join them and free the pool.
+ */
+static void
+stopThreads(MatrixMulThreads *pool, int nStarted)
+{
+	pthread_mutex_lock(&pool -> lock);
+	pool -> stop = true;
+	pthread_cond_broadcast(&pool -> start);
+	pthread_mutex_unlock(&pool -> lock);
+	for(int i = 0; i < nStarted; i++)
+	{
+		pthread_join(pool -> threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool -> done);
+	pthread_cond_destroy(&pool -> start);
+	pthread_mutex_destroy(&pool -> lock);
+	free(pool -> owners);
+	free(pool -> tids);
+	free(pool -> threads);
+	free(pool);
+}
+
+MatrixMulThreads *
+newMatrixMulThreads(int nThreads, const int *cpus, int nCpus, int *err)
+{
+	MatrixMulThreads *pool = calloc(1, sizeof(MatrixMulThreads));
+	if(pool == NULL)
+	{
+		*err = errno;
+		return NULL;
+	}
+	pool -> nThreads = nThreads;
+	pool -> threads = calloc(nThreads, sizeof(pthread_t));
+	pool -> tids = calloc(nThreads, sizeof(pid_t));
+	if(pool -> threads == NULL || pool -> tids == NULL)
+	{
+		*err = ENOMEM;
+		free(pool -> tids);
+		free(pool -> threads);
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool -> lock, NULL);
+	pthread_cond_init(&pool -> start, NULL);
+	pthread_cond_init(&pool -> done, NULL);
+
+	for(int i = 0; i < nThreads; i++)
+	{
+		ThreadStart *start = malloc(sizeof(ThreadStart));
+		int rc = (start == NULL) ? ENOMEM : 0;
+		if(start != NULL)
+		{
+			*start = (ThreadStart) { .pool = pool, .index = i };
+			rc = pthread_create(&pool -> threads[i], NULL, runThread, start);
+			if(rc != 0)
+			{
+				free(start);
+			}
+		}
+		if(rc != 0)
+		{
+			*err = rc;
+			stopThreads(pool, i);
+			return NULL;
+		}
+
+		/**
+		 * Each thread on its own CPU while there are enough of them,
+		 * wrapping around otherwise
+		 */
+		if(cpus != NULL && nCpus > 0)
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[i % nCpus], &set);
+			if(pthread_setaffinity_np(pool -> threads[i], sizeof(set), &set) != 0)
+			{
+				error("thread %d: cannot set CPU affinity", i);
+			}
+		}
+	}
+	return pool;
+}
+
+/**
+ * Write the trace lines of the product c[n1][n3]: every dot product,
+ * in row-major order, attributed to the thread which computed it.
+ */
+static void
+writeTrace(const MatrixMulThreads *pool)
+{
+	for(int row = 0; row < pool -> n1; row++)
+	{
+		int index = pool -> owners[row];
+		const MatrixBaseType *cRow = pool -> c + (size_t) row * pool -> n3;
+		for(int col = 0; col < pool -> n3; col++)
+		{
+			fprintf(pool -> trace, "%d[%d]: [%d]x[%d] = %d\n", index, (int) pool -> tids[index],
+				row, col, cRow[col]);
+		}
+	}
+	fflush(pool -> trace);
+}
+
+void
+mulMatrixMulThreads(MatrixMulThreads *pool, int n1, int n2, int n3,
+		    const MatrixBaseType *a, const MatrixBaseType *b,
+		    MatrixBaseType *c, FILE *trace, int *err)
+{
+	if(trace != NULL && (size_t) n1 > pool -> ownersCapacity)
+	{
+		int *owners = realloc(pool -> owners, n1 * sizeof(int));
+		if(owners == NULL)
+		{
+			*err = ENOMEM;
+			return;
+		}
+		pool -> owners = owners;
+		pool -> ownersCapacity = n1;
+	}
+
+	pthread_mutex_lock(&pool -> lock);
+	pool -> n1 = n1;
+	pool -> n2 = n2;
+	pool -> n3 = n3;
+	pool -> a = a;
+	pool -> b = b;
+	pool -> c = c;
+	pool -> trace = trace;
+	pool -> nextRow = 0;
+	pool -> minRows = guidedMinRows(n1, n2, pool -> nThreads);
+	pool -> running = pool -> nThreads;
+	pool -> generation++;
+	pthread_cond_broadcast(&pool -> start);
+	while(pool -> running > 0)
+	{
+		pthread_cond_wait(&pool -> done, &pool -> lock);
+	}
+	pthread_mutex_unlock(&pool -> lock);
+
+	if(pool -> trace != NULL)
+	{
+		writeTrace(pool);
+	}
+}
+
+void
+freeMatrixMulThreads(MatrixMulThreads *pool)
+{
+	stopThreads(pool, pool -> nThreads);
+}
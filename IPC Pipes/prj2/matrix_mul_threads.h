@@ -0,0 +1,31 @@
+#ifndef _MATRIX_MUL_THREADS_H
+#define _MATRIX_MUL_THREADS_H
+
+#include "matrix_mul.h"
+
+#include <stdio.h>
+
+/** In-process backend of a MatrixMul constructed with
+ *  MATRIX_MUL_THREADS: a pool of pthreads which stay alive across
+ *  multiplications and share a, b and c with the client directly.
+ */
+typedef struct MatrixMulThreads MatrixMulThreads;
+
+/** Start nThreads worker threads.  If cpus is not NULL, thread i is
+ *  pinned to cpus[i % nCpus].  Return NULL with *err set on error.
+ */
+MatrixMulThreads *newMatrixMulThreads(int nThreads, const int *cpus,
+                                      int nCpus, int *err);
+
+/** Set c[n1][n3] to a[n1][n2] * b[n2][n3] using the threads of pool,
+ *  writing the same trace lines as the process backend to trace, if
+ *  not NULL.  Set *err on error.
+ */
+void mulMatrixMulThreads(MatrixMulThreads *pool, int n1, int n2, int n3,
+                         const MatrixBaseType *a, const MatrixBaseType *b,
+                         MatrixBaseType *c, FILE *trace, int *err);
+
+/** Stop and join the threads of pool and free it. */
+void freeMatrixMulThreads(MatrixMulThreads *pool);
+
+#endif //ifndef _MATRIX_MUL_THREADS_H
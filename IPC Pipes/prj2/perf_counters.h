@@ -0,0 +1,90 @@
+#ifndef _PERF_COUNTERS_H
+#define _PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Hardware events collected by a PerfCounters set. */
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  N_PERF_EVENTS
+} PerfEvent;
+
+/** A set of perf_event_open(2) counters attached to one process.  A
+ *  counter which the kernel or hardware does not provide (no PMU in a
+ *  VM, perf_event_paranoid too high, ...) has fd -1 and is simply
+ *  reported as unavailable.  Counters are opened as one group led by
+ *  PERF_CYCLES where possible, so that they count over the same time
+ *  window; inGroup tells which ones are in it.
+ */
+typedef struct PerfCounters {
+  int fds[N_PERF_EVENTS];
+  bool inGroup[N_PERF_EVENTS];
+} PerfCounters;
+
+/** Counter values accumulated between startPerfCounters() and
+ *  stopPerfCounters().  Values are scaled up when the kernel had to
+ *  multiplex the counters.
+ */
+typedef struct PerfSample {
+  long long values[N_PERF_EVENTS];
+  bool valid[N_PERF_EVENTS];
+} PerfSample;
+
+/** Open disabled counters for process pid (0 for the calling process)
+ *  including threads and children it creates afterwards.  Never fails:
+ *  unavailable events are left closed.
+ */
+void openPerfCounters(PerfCounters *counters, pid_t pid);
+
+/** Close all counters of the set. */
+void closePerfCounters(PerfCounters *counters);
+
+/** Return true if at least one event of the set is available. */
+bool hasPerfCounters(const PerfCounters *counters);
+
+/** Reset and enable all counters of the set. */
+void startPerfCounters(PerfCounters *counters);
+
+/** Disable all counters of the set and read them into *sample. */
+void stopPerfCounters(PerfCounters *counters, PerfSample *sample);
+
+/** Add the valid values of from into *to. */
+void addPerfSample(PerfSample *to, const PerfSample *from);
+
+/** Return a short name such as "cycles" or "dtlb-misses" for event. */
+const char *perfEventName(PerfEvent event);
+
+/** Format sample into buf as space separated name=value pairs, with
+ *  values divided by nOps and an ipc entry when cycles and
+ *  instructions are both valid; unavailable events read "n/a".
+ */
+void formatPerfSample(const PerfSample *sample, double nOps, char *buf,
+                      size_t size);
+
+/** Return monotonic time in nanoseconds. */
+double perfNowNs(void);
+
+/** Sort the n timings of samples in ascending order. */
+void sortPerfTimes(double samples[], int n);
+
+/** Return the q quantile of the n sorted timings (nearest rank). */
+double perfTimeQuantile(const double sorted[], int n, double q);
+
+/** Time and count a single call, for example
+ *
+ *    PERF_CALL(&counters, &sample, m -> fns -> mul(m, b, c, &err));
+ */
+#define PERF_CALL(counters, sample, call)       \
+  do {                                          \
+    startPerfCounters(counters);                \
+    call;                                       \
+    stopPerfCounters(counters, sample);         \
+  } while (0)
+
+#endif //ifndef _PERF_COUNTERS_H
@@ -2,6 +2,11 @@
 /**
  * The source file includes client code to send matrix data to the server.
  * It maps the shared memory segment created by the server.
+ * Each request goes through a free slot of the segment, so concurrent
+ * clients are served in parallel.  Slots are submitted to the server and
+ * completed through lock-free queues in the segment; a client only enters
+ * the kernel when it has to wait.  The matrices go to the slot's own data
+ * segment, which the server grows when a request needs more room.
  */
 
 
@@ -10,6 +15,8 @@
  */
 #include "common.h"
 #include "matmul.h"
+#include "matmul_zero_copy.h"
+#include "matmul_wait.h"
 #include "errors.h"
 
 //#define DO_TRACE 1
@@ -19,7 +26,6 @@
 /**
  * Standard header files
  */
-#include <semaphore.h>
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
@@ -28,9 +34,19 @@
 #include <sys/stat.h>
 #include <stdio.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
 
+/**
+ * Request handle.
+ * The claimed slot and the ticket of the claim, 0 once the request ended.
+ */
+struct MatrixMulRequest {
+	MatrixSlot *slot;
+	uint32_t ticket;
+};
+
 /**
  * Matrix Mul Instance
  */
@@ -43,24 +59,63 @@ struct MatrixMul {
 	int fd;
 
 	/**
-	 * Matrix Data.
-	 * Data mapped in memory.
-	 */
-	MatrixData *matrixData;
-
-	/**
-	 * Semaphores.
-	 * Used multiple semaphores instances.
+	 * Segment header.
+	 * Data mapped in memory, followed by the request slots.
 	 */
-	sem_t *sems[N_SEMS];
+	ShmHeader *header;
 
 	/**
 	 * Memory Size
 	 * Mapped memory size 
 	 */
 	long shmMemSize;
+
+	/**
+	 * Mappings of the data segments of the slots, remapped when the
+	 * server has grown a segment, and the handle of this client's
+	 * request in each slot
+	 */
+	struct SlotMapping {
+		MatrixBaseType *data;
+		long size;
+		MatrixMulRequest request;
+	} *slotMappings;
+
+	/**
+	 * Wait mode.
+	 * With MATMUL_WAIT_ADAPTIVE, the current spin budget in pause
+	 * iterations and the number of waits so far.
+	 */
+	MatMulWait wait;
+	int spinLimit;
+	unsigned nWaits;
 };
 
+/**
+ * Bounds of the adaptive spin budget, in pause iterations.
+ * A pause takes some tens of cycles, so the longest spin is a few
+ * tens of microseconds.
+ */
+ #define MIN_SPIN 16
+ #define MAX_SPIN 4096
+
+/**
+ * Every PROBE_INTERVAL adaptive waits spin for MAX_SPIN, so a budget
+ * shrunk by long requests grows again once requests get short.
+ */
+ #define PROBE_INTERVAL 64
+
+/**
+ * Return monotonic time in nanoseconds
+ */
+static long
+nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
 
 
 /**
@@ -75,105 +130,221 @@ MatrixMul matrixMul;
 
 
 /**
- * Initialization of semaphore instances to be used in order send matrix data from client to server and receive response from the server.
+ * Claim a free slot of the segment, waiting for one if all are busy,
+ * and set *ticket to the ticket of the claim.
+ * The scan starts at a slot chosen by pid to spread concurrent clients.
  */
-static SemOpenArgsClient semArgs[] = {
-
-	{ 
-		.posixName = SERVER_SEM_NAME,
-		.oflags = O_RDWR,
-	},
-
-	{ 
-		.posixName = REQUEST_SEM_NAME,
-		.oflags = O_RDWR,
-	},
-
-	{ 
-		.posixName = RESPONSE_SEM_NAME,
-		.oflags = O_RDWR,
-	},
-};
+static MatrixSlot *
+claimSlot(const MatrixMul *matMul, uint32_t *ticket)
+{
+	ShmHeader *header = matMul -> header;
+	int nSlots = header -> nSlots;
+	int first = getpid() % nSlots;
+
+	/**
+	 * Ticket of this claim, never 0 which marks a free slot
+	 */
+	uint32_t claim;
+	do
+	{
+		claim = __atomic_add_fetch(&header -> claimSeq, 1, __ATOMIC_RELAXED);
+	} while(claim == 0);
+
+	while(1)
+	{
+		uint32_t freeSeq = __atomic_load_n(&header -> freeSeq, __ATOMIC_SEQ_CST);
+		for(int i = 0; i < nSlots; i++)
+		{
+			MatrixSlot *slot = shmSlot(header, (first + i) % nSlots);
+			uint32_t expected = 0;
+			if(__atomic_compare_exchange_n(&slot -> busy, &expected, claim, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			{
+				*ticket = claim;
+				return slot;
+			}
+		}
+
+		/**
+		 * All busy: sleep until a slot is released
+		 */
+		waitWord(&header -> freeSeq, freeSeq, &header -> freeWaiters);
+	}
+}
 
 /**
- * Semaphore wait operation .
- * It blocks the client when sem value is zero.
- * This is similar to sleep operation in general.
+ * Release a slot claimed by claimSlot() with ticket.
+ * Return false, leaving the slot alone, if it is no longer held by that
+ * claim.
  */
-static void
-semWait(sem_t *sem, const char *posixName, int *err)
+static bool
+releaseSlot(const MatrixMul *matMul, MatrixSlot *slot, uint32_t ticket)
 {
-	if(sem_wait(sem) < 0) 
+	if(!__atomic_compare_exchange_n(&slot -> busy, &ticket, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
 	{
-		*err = errno;
-		fatal("Cannot wait on sem : %s\n", posixName);
+		return false;
 	}
+	bumpWord(&matMul -> header -> freeSeq, &matMul -> header -> freeWaiters, 1);
+	return true;
 }
 
 /**
- * Semaphore post operation.
- * It wakes up all the processes waiting on this sem and schdules either of them only one.
- * It is similar to wakeup call in general.
+ * Return true if slot is still held by the claim with ticket
  */
-static void
-semPost(sem_t *sem, const char *posixName, int *err)
+static bool
+holdsSlot(MatrixSlot *slot, uint32_t ticket)
 {
-	if(sem_post(sem) < 0) 
+	return ticket != 0 &&
+	       __atomic_compare_exchange_n(&slot -> busy, &ticket, ticket, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/**
+ * Return the index of slot
+ */
+static int
+slotIndex(const MatrixMul *matMul, const MatrixSlot *slot)
+{
+	ShmHeader *header = matMul -> header;
+	return ((const char *) slot - ((const char *) header + header -> slotsOffset)) / header -> slotSize;
+}
+
+/**
+ * Map the data segment of slot i with its current size, unless it
+ * already is.  Return 0 or an error number.
+ */
+static int
+mapSlotData(const MatrixMul *matMul, int i, long size)
+{
+	struct SlotMapping *mapping = &matMul -> slotMappings[i];
+	if(mapping -> data != NULL && mapping -> size == size)
+	{
+		return 0;
+	}
+
+	char name[SLOT_SHM_NAME_MAX];
+	slotShmName(name, i);
+	int fd = shm_open(name, O_RDWR, 0);
+	if(fd < 0)
 	{
-		*err = errno;		
-		fatal("Cannot post sem : %s\n", posixName);
+		return errno;
 	}
+	MatrixBaseType *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int err = (data == MAP_FAILED) ? errno : 0;
+	close(fd);
+	if(err != 0)
+	{
+		return err;
+	}
+
+	if(mapping -> data != NULL)
+	{
+		munmap(mapping -> data, mapping -> size);
+	}
+	mapping -> data = data;
+	mapping -> size = size;
+	return 0;
 }
 
-/** Return an interface to the client end of a client-server matrix
- *  multiplier.
- *
- *  Set *err to an appropriate error number (documented in errno(3))
- *  on error.
- *
+/**
+ * Spin loop hint
  */
-MatrixMul *
-newMatrixMul(int *err)
+static inline void
+cpuRelax(void)
 {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
 
-	/**
-	 * Initialize the semaphores
-	 */
-	for(int i = 0; i < N_SEMS; i++) 
+/**
+ * Wait for the completion of slot, whose doneSeq was doneSeq when the
+ * request was submitted, as selected by the wait mode of matMul.
+ */
+static void
+waitCompletion(const MatrixMul *matMul, MatrixSlot *slot, uint32_t doneSeq)
+{
+	struct MatrixMul *mutableMatMul = (struct MatrixMul *) matMul;
+	switch(matMul -> wait)
 	{
-		const SemOpenArgsClient *p = &semArgs[i];
-		if((matrixMul.sems[i] = sem_open(p->posixName, p->oflags)) == NULL) 
+	case MATMUL_WAIT_SPIN:
+		while(__atomic_load_n(&slot -> doneSeq, __ATOMIC_ACQUIRE) == doneSeq)
 		{
-			*err = errno;
-			fatal("newMatrixMul() : Cannot open semaphore %s\n", p->posixName);
-			return NULL;
+			cpuRelax();
 		}
+		return;
+
+	case MATMUL_WAIT_ADAPTIVE:
+	{
+		/**
+		 * Completed within the budget: move the budget towards twice
+		 * the spin it took.  Had to sleep: double the budget if the
+		 * completion came no later after the spin than the spin took,
+		 * so a somewhat longer spin would have caught it, else shrink
+		 * it.  A probe spins for MAX_SPIN whatever the budget.
+		 */
+		int spinLimit = __atomic_load_n(&matMul -> spinLimit, __ATOMIC_RELAXED);
+		unsigned nWaits = __atomic_fetch_add(&mutableMatMul -> nWaits, 1, __ATOMIC_RELAXED);
+		int budget = (nWaits % PROBE_INTERVAL == 0) ? MAX_SPIN : spinLimit;
+		long spinBegin = nowNs();
+		for(int spin = 0; spin < budget; spin++)
+		{
+			if(__atomic_load_n(&slot -> doneSeq, __ATOMIC_ACQUIRE) != doneSeq)
+			{
+				spinLimit += (2 * spin - spinLimit) / 8;
+				spinLimit = (spinLimit < MIN_SPIN) ? MIN_SPIN : (spinLimit > MAX_SPIN) ? MAX_SPIN : spinLimit;
+				__atomic_store_n(&mutableMatMul -> spinLimit, spinLimit, __ATOMIC_RELAXED);
+				return;
+			}
+			cpuRelax();
+		}
+		long sleepBegin = nowNs();
+		waitWord(&slot -> doneSeq, doneSeq, &slot -> doneWaiters);
+		if(nowNs() - sleepBegin <= sleepBegin - spinBegin)
+		{
+			spinLimit = (2 * budget > MAX_SPIN) ? MAX_SPIN : 2 * budget;
+		}
+		else
+		{
+			spinLimit -= spinLimit / 4;
+			spinLimit = (spinLimit < MIN_SPIN) ? MIN_SPIN : spinLimit;
+		}
+		__atomic_store_n(&mutableMatMul -> spinLimit, spinLimit, __ATOMIC_RELAXED);
+		return;
 	}
 
+	default:
+		waitWord(&slot -> doneSeq, doneSeq, &slot -> doneWaiters);
+		return;
+	}
+}
 
-	FILE *fp = NULL;
-        long shmMemSize;
+void
+setMatrixMulWait(MatrixMul *matMul, MatMulWait wait)
+{
 
-	/** 
-	 * Open the file for reading
+	/**
+	 * Spinning on a single CPU only delays the server
 	 */
-        fp = fopen(MEM_SIZE_SHARED_FILE, "r");
-        if(fp == NULL) 
+	if(wait == MATMUL_WAIT_ADAPTIVE && sysconf(_SC_NPROCESSORS_ONLN) <= 1)
 	{
-	   *err = errno;	
-           fatal("newMatrixMul() : Cannot open file for reading.\n");
-        }
-	
-	/**
-	 * Read memory size
-	 */ 
-	fscanf(fp, "%ld", &shmMemSize);
-	matrixMul.shmMemSize = shmMemSize;
+		wait = MATMUL_WAIT_BLOCK;
+	}
+	matMul -> wait = wait;
+	matMul -> spinLimit = MAX_SPIN / 4;
+	matMul -> nWaits = 0;
+}
 
-	/**
-	 * Close the resource
-	 */
-	 fclose(fp);
+/** Return an interface to the client end of a client-server matrix
+ *  multiplier.
+ *
+ *  Set *err to an appropriate error number (documented in errno(3))
+ *  on error.
+ *
+ */
+MatrixMul *
+newMatrixMul(int *err)
+{
 
 	/**
 	 * Shared memory mapping name
@@ -188,18 +359,69 @@ newMatrixMul(int *err)
 
 	matrixMul.fd = fd;
 
-	matrixMul.matrixData = NULL;	
+	/**
+	 * Memory size, that of the segment
+	 */
+	struct stat shmStat;
+	if(fstat(fd, &shmStat) < 0 || shmStat.st_size < (off_t) sizeof(ShmHeader))
+	{
+		*err = EAGAIN;
+		fatal("newMatrixMul() : Shm %s not ready\n", SHM_NAME);
+		return NULL;
+	}
+	long shmMemSize = shmStat.st_size;
+	matrixMul.shmMemSize = shmMemSize;
+
+	matrixMul.header = NULL;	
 
 	/**
 	 * Actual Memory Mapping initialization using system call given
 	 */
-	if((matrixMul.matrixData = mmap(NULL, shmMemSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) 
+	if((matrixMul.header = mmap(NULL, shmMemSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) 
 	{
 		*err = errno;
 		fatal("newMatrixMul() : Cannot mmap shm %s\n", SHM_NAME);
 		return NULL;
 	}
 
+	/**
+	 * The server initializes the header last
+	 */
+	if(__atomic_load_n(&matrixMul.header -> ready, __ATOMIC_ACQUIRE) != SHM_READY)
+	{
+		*err = EAGAIN;
+		fatal("newMatrixMul() : Shm %s not ready\n", SHM_NAME);
+		return NULL;
+	}
+
+	/**
+	 * Data segments are mapped on first use
+	 */
+	matrixMul.slotMappings = calloc(matrixMul.header -> nSlots, sizeof(struct SlotMapping));
+	if(matrixMul.slotMappings == NULL)
+	{
+		*err = ENOMEM;
+		fatal("newMatrixMul() : Cannot allocate slot mappings\n");
+		return NULL;
+	}
+
+	/**
+	 * Wait mode from the environment
+	 */
+	const char *wait = getenv("MATMUL_WAIT");
+	if(wait != NULL && strcmp(wait, "block") == 0)
+	{
+		setMatrixMulWait(&matrixMul, MATMUL_WAIT_BLOCK);
+	}
+	else if(wait != NULL && strcmp(wait, "spin") == 0)
+	{
+		setMatrixMulWait(&matrixMul, MATMUL_WAIT_SPIN);
+	}
+	else
+	{
+		setMatrixMulWait(&matrixMul, MATMUL_WAIT_ADAPTIVE);
+	}
+
 	return &matrixMul;		
 }
 
@@ -224,116 +446,195 @@ freeMatrixMul(MatrixMul *matMul, int *err)
     /**
      * Unmap mapped memory
      */				
-    if(munmap(matMul -> matrixData, matMul -> shmMemSize) < 0) 
+    for(int i = 0; i < matMul -> header -> nSlots; i++)
+    {
+	if(matMul -> slotMappings[i].data != NULL)
+	{
+	    munmap(matMul -> slotMappings[i].data, matMul -> slotMappings[i].size);
+	}
+    }
+    free(matMul -> slotMappings);
+    matMul -> slotMappings = NULL;
+
+    if(munmap(matMul -> header, matMul -> shmMemSize) < 0) 
     {
 	*err = errno;
 	fatal("freeMatrixMul() : Cannot Unmap\n");
     }
 
-  
-    /**
-     * Close semaphores
-     */	
-     for(int i = 0; i < N_SEMS; i++)
-     {
-             sem_close(matrixMul.sems[i]); 
-     }
-	
-		
 }
 
-void
-mulMatrixMul(const MatrixMul *matMul, int n1, int n2, int n3,
-		CONST MatrixBaseType a[n1][n2],
-		CONST MatrixBaseType b[n2][n3],
-		MatrixBaseType c[n1][n3], int *err)
+/**
+ * Run operation op on slot and wait for its completion.
+ * Return the error number of the server.
+ */
+static int
+runSlot(const MatrixMul *matMul, MatrixSlot *slot, int op)
 {
+	MatrixData *matrixData = &slot -> matrixData;
 
+	/**
+	 * Deal with an error on server side
+	 */
+	matrixData -> err = 0;
+	slot -> op = op;
 
 	/**
-	 * Check for the map size whether array would fit in or not
-	 * First entry is for integer error value
+	 * Submit the slot and wait for its completion
 	 */
-	long totalSize = sizeof(int) + sizeof(n1) + sizeof(n2) + sizeof(n3) + n1*n2*sizeof(MatrixBaseType) + n2*n3*sizeof(MatrixBaseType) + n1*n3*sizeof(MatrixBaseType);
-	if(totalSize > matMul -> shmMemSize)
+	uint32_t doneSeq = __atomic_load_n(&slot -> doneSeq, __ATOMIC_ACQUIRE);
+	submitSlot(matMul -> header, slotIndex(matMul, slot));
+	waitCompletion(matMul, slot, doneSeq);
+	return matrixData -> err;
+}
+
+MatrixMulRequest *
+beginMatrixMulRequest(const MatrixMul *matMul, int n1, int n2, int n3,
+		      MatrixBaseType **a, MatrixBaseType **b, MatrixBaseType **c, int *err)
+{
+	if(n1 < 0 || n2 < 0 || n3 < 0)
 	{
-		fprintf(stderr, "matMul(): Value too large for defined data type\n");
-		freeMatrixMul((struct MatrixMul *) matMul, err);
-		exit(EXIT_FAILURE);
+		*err = EINVAL;
+		return NULL;
 	}
 
-	/**	
-	 * Wait semaphore
+	/**
+	 * Reject dimensions whose matrices would overflow the largest data
+	 * segment before asking the server for one
 	 */
-	semWait(matMul -> sems[SERVER_SEM], SERVER_SEM_NAME, err);
+	long need = 0;
+	int sizeErr = slotBytes(n1, n2, n3, matMul -> header -> maxDataSize, &need);
+	if(sizeErr != 0)
+	{
+		*err = sizeErr;
+		return NULL;
+	}
 
 	/**
-	 * Deal with an error on server side
+	 * Slot of this request
 	 */
-	matMul -> matrixData -> err = 0;
+	uint32_t ticket;
+	MatrixSlot *slot = claimSlot(matMul, &ticket);
+	MatrixData *matrixData = &slot -> matrixData;
 
 	/**
 	 * Set dimension data into the memory
 	 * rows and columns
 	 */ 
-	matMul -> matrixData -> n1 = n1;
-	matMul -> matrixData -> n2 = n2;
-	matMul -> matrixData -> n3 = n3;
+	matrixData -> n1 = n1;
+	matrixData -> n2 = n2;
+	matrixData -> n3 = n3;
 
-	
 	/**
-	 * Matrix data A mapped into the memory
-	 */ 
-	for(int i = 0; i < n1; i++)
-		for(int j = 0; j < n2; j++) 
-			*(&matMul -> matrixData -> ABCMatrices + i*n2 + j) = a[i][j];
+	 * Check for the data segment size whether array would fit in or not,
+	 * asking the server to grow it if not, and map it at its current size
+	 */
+	int slotErr = 0;
+	if(need > __atomic_load_n(&slot -> dataSize, __ATOMIC_ACQUIRE))
+	{
+		slotErr = runSlot(matMul, slot, SLOT_RESIZE);
+	}
+	if(slotErr == 0)
+	{
+		slotErr = mapSlotData(matMul, slotIndex(matMul, slot), __atomic_load_n(&slot -> dataSize, __ATOMIC_ACQUIRE));
+	}
+	if(slotErr != 0)
+	{
+		*err = slotErr;
+		releaseSlot(matMul, slot, ticket);
+		return NULL;
+	}
 
 	/**
-	 * Matrix B offset - Relative address to the beginning memory block A
-	 * 
+	 * Matrix A, B and C in the data segment, each relative to the beginning of A
 	 */
-	int BOffset = n1 * n2;
+	struct SlotMapping *mapping = &matMul -> slotMappings[slotIndex(matMul, slot)];
+	*a = mapping -> data;
+	*b = *a + (long) n1*n2;
+	*c = *b + (long) n2*n3;
 
+	mapping -> request = (MatrixMulRequest) { .slot = slot, .ticket = ticket };
+	return &mapping -> request;
+}
+
+void
+runMatrixMulRequest(const MatrixMul *matMul, MatrixMulRequest *request, int *err)
+{
 
 	/**
-	 * Matrix data B mapped into the memory
-	 *
+	 * Reject a request which has ended
 	 */
-	for(int i = 0; i < n2; i++) 
-		for(int j = 0; j < n3; j++) 
-			*(&matMul -> matrixData -> ABCMatrices + BOffset + i*n3 + j) = b[i][j];
-
-
-	semPost(matMul -> sems[REQUEST_SEM], REQUEST_SEM_NAME, err);
-	semWait(matMul -> sems[RESPONSE_SEM], RESPONSE_SEM_NAME, err);
+	if(request == NULL || !holdsSlot(request -> slot, request -> ticket))
+	{
+		*err = EINVAL;
+		return;
+	}
 
 	/**
 	 * Check for an error in memory mapping while receving reponse from the server
 	 */
-	if(matMul -> matrixData -> err != 0)
+	int serverErr = runSlot(matMul, request -> slot, SLOT_MULTIPLY);
+	if(serverErr != 0)
 	{
-		*err = matMul -> matrixData -> err;
-		fprintf(stderr, "matMul(): error in server %s\n", strerror(*err));
-                exit(EXIT_FAILURE);	
+		*err = serverErr;
 	}
-	
+}
+
+void
+endMatrixMulRequest(const MatrixMul *matMul, MatrixMulRequest *request, int *err)
+{
 
 	/**
-	 * Matrix C offset - Relative address to the beginning memory block A
+	 * Ready for the next client request to handle, unless the request
+	 * failed to begin or has ended already and the slot is free or
+	 * another claim's
 	 */
-	int COffest = BOffset + n1*n3;
+	if(request == NULL || request -> ticket == 0 ||
+	   !releaseSlot(matMul, request -> slot, request -> ticket))
+	{
+		*err = EINVAL;
+		return;
+	}
+	request -> ticket = 0;
+}
+
+void
+mulMatrixMul(const MatrixMul *matMul, int n1, int n2, int n3,
+		CONST MatrixBaseType a[n1][n2],
+		CONST MatrixBaseType b[n2][n3],
+		MatrixBaseType c[n1][n3], int *err)
+{
+	MatrixBaseType *slotA, *slotB, *slotC;
+	MatrixMulRequest *request = beginMatrixMulRequest(matMul, n1, n2, n3, &slotA, &slotB, &slotC, err);
+	if(request == NULL)
+	{
+		fprintf(stderr, "matMul(): Cannot get room for the matrices %s\n", strerror(*err));
+		freeMatrixMul((struct MatrixMul *) matMul, err);
+		exit(EXIT_FAILURE);
+	}
 
+	/**
+	 * Matrix data A and B mapped into the memory
+	 */ 
+	for(int i = 0; i < n1; i++)
+		memcpy(slotA + (long) i*n2, a[i], n2 * sizeof(MatrixBaseType));
+	for(int i = 0; i < n2; i++) 
+		memcpy(slotB + (long) i*n3, b[i], n3 * sizeof(MatrixBaseType));
+
+	int serverErr = 0;
+	runMatrixMulRequest(matMul, request, &serverErr);
+	if(serverErr != 0)
+	{
+		*err = serverErr;
+		fprintf(stderr, "matMul(): error in server %s\n", strerror(*err));
+                exit(EXIT_FAILURE);	
+	}
 
 	/**
-	 * Set Matrix C into the memory
+	 * Set Matrix C from the memory
 	 */
 	for(int i = 0; i < n1; i++) 
-		for(int j = 0; j < n3; j++)  
-			c[i][j] = *(&matMul -> matrixData -> ABCMatrices + COffest + i*n3 + j);
+		memcpy(c[i], slotC + (long) i*n3, n3 * sizeof(MatrixBaseType));
 
-	/**
-	 * Ready for the next client request to handle
-	 */
-	semPost(matMul -> sems[SERVER_SEM], SERVER_SEM_NAME, err);
+	endMatrixMulRequest(matMul, request, err);
 }
-
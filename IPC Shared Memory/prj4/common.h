@@ -5,10 +5,16 @@
  * Standard header files
  */ 
 #include "mat_base.h"
+#include <errno.h>
+#include <linux/futex.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 
 
@@ -28,37 +34,41 @@
  #define SHM_NAME POSIX_IPC_NAME_PREFIX "shm"
 
 /**
- * Client-Server Semaphore Object 
- */ 
+ * Name of the data segment of a request slot, formatted with the
+ * slot index.  The matrices of a slot's requests live there.
+ */
 
- #define SERVER_SEM_NAME POSIX_IPC_NAME_PREFIX "server"
+ #define SLOT_SHM_NAME_FORMAT POSIX_IPC_NAME_PREFIX "slot-%d"
+ #define SLOT_SHM_NAME_MAX 64
 
-/** Name of well-known requests FIFO used by both clients
- *  and server. It is used to send memory size from the server
- *  towards client.
+/**
+ * Value of ShmHeader.ready once the daemon has initialized the segment.
+ * Clients take the segment size from the segment itself.
  */
- #define MEM_SIZE_SHARED_FILE "MemorySize.txt"
+ #define SHM_READY 0x6d6d3421
 
 /**
- * Client-Server Request Semaphore Object
+ * Default number of request slots in the shared memory segment.
+ * The daemon services every slot independently, so up to this
+ * many clients are served at the same time.
  */
- #define REQUEST_SEM_NAME POSIX_IPC_NAME_PREFIX "request"
+ #define DEFAULT_N_SLOTS 4
 
 /**
- * Client-Server Response Semaphore Object 
+ * Alignment of the slots in the shared memory segment.
+ * Slots never share a cache line.
  */
- #define RESPONSE_SEM_NAME POSIX_IPC_NAME_PREFIX "response"
+ #define SLOT_ALIGN 64
+
 
 /**
- * Enum constants
+ * Largest data segment of a slot.  Requests whose matrices don't fit
+ * are rejected with EOVERFLOW and the daemon never grows a segment
+ * beyond it.  Both sides read the daemon's value from ShmHeader.
  */
- enum {
-  	SERVER_SEM,
-  	REQUEST_SEM,
-  	RESPONSE_SEM,
-  	N_SEMS
- };
-
+#ifndef MAX_SLOT_DATA_SIZE
+ #define MAX_SLOT_DATA_SIZE (1L << 30)
+#endif
 
 /**
  * Permissions for the shared memory segment
@@ -67,41 +77,204 @@
 
 
 /**
- * Semaphore used for server side
+ * Matrix Data. 
+ * It has rows and column dimension of each matrix.
+ * The three matrices are stored one after the other at the start of
+ * the slot's data segment.
+ */ 
+ typedef struct MatrixData {
+
+	int err;
+	int n1;
+	int n2;
+	int n3;
+
+ } MatrixData;
+
+/**
+ * Operations of a request
+ */
+ enum {
+	SLOT_MULTIPLY,		// compute C from A and B
+	SLOT_RESIZE,		// grow the data segment to hold n1, n2, n3
+ };
+
+/**
+ * Request slot.
+ * A client claims a free slot, writes its request into matrixData and
+ * submits the slot; the daemon computes C in place and bumps doneSeq.
+ * busy is 0 while the slot is free, else the ticket of the claim holding
+ * it, so a client can tell its claim from a later one of the same slot.
+ * dataSize is the size of the slot's data segment, changed by the daemon
+ * only on a SLOT_RESIZE request, after which clients remap the segment.
+ */
+ typedef struct MatrixSlot {
+
+	uint32_t busy;
+	uint32_t doneSeq;
+	uint32_t doneWaiters;
+	int op;
+	long dataSize;
+	MatrixData matrixData;
+
+ } MatrixSlot;
+
+/**
+ * Cell of the submission queue.
+ * seq is position + 1 once the cell holds the slot submitted at position.
  */
- typedef struct SemOpenArgsServer {
+ typedef struct SubmitCell {
 
-	const char *posixName;
-  	int oflags;
-  	mode_t mode;
-  	unsigned initValue;
+	uint32_t seq;
+	int32_t slot;
 
- } SemOpenArgsServer;
+ } SubmitCell;
 
 /**
- * Semaphore used for client side
+ * Shared memory segment header.
+ * The segment holds this header followed by nSlots slots of
+ * slotSize bytes each, starting at slotsOffset.  Each slot has its own
+ * data segment, so the segment itself stays small.
+ *
+ * Requests go through a lock-free queue: clients reserve a position at
+ * submitTail and publish their slot in its cell (many producers), the
+ * daemon consumes the cells in order (one consumer).  Completions are
+ * reported per slot in doneSeq (one producer, one consumer).  A side
+ * only enters the kernel, through a futex on the word it waits for,
+ * when it finds nothing to do; the other side only wakes it when it
+ * has announced itself in the matching waiters count.
  */
- typedef struct SemOpenArgsClient {
+ typedef struct ShmHeader {
 
-	  const char *posixName;
-	  int oflags;
+	uint32_t ready;
+	int nSlots;
+	long slotSize;
+	long slotsOffset;
+	long shmSize;
+	long maxDataSize;
+	uint32_t submitMask;
 
- } SemOpenArgsClient;
+	/**
+	 * Free slots: bumped on every release
+	 */
+	_Alignas(SLOT_ALIGN) uint32_t freeSeq;
+	uint32_t freeWaiters;
 
+	/**
+	 * Ticket of the last claim of a slot
+	 */
+	uint32_t claimSeq;
+
+	/**
+	 * Submission queue
+	 */
+	_Alignas(SLOT_ALIGN) uint32_t submitTail;
+	_Alignas(SLOT_ALIGN) uint32_t submitted;
+	uint32_t daemonWaiting;
+	_Alignas(SLOT_ALIGN) SubmitCell submitCells[];
+
+ } ShmHeader;
 
 /**
- * Matrix Data. 
- * It has rows and column dimension of each matrix.
- * It contains the matrix used to store all the three matrices in shared memory segment.
- */ 
- typedef struct MatrixData {
+ * Return slot i of the segment starting at header
+ */
+ static inline MatrixSlot *
+ shmSlot(ShmHeader *header, int i)
+ {
+	return (MatrixSlot *) ((char *) header + header -> slotsOffset + i * header -> slotSize);
+ }
 
-	int err;
-	int n1;
-	int n2;
-	int n3;
-	MatrixBaseType ABCMatrices;
+/**
+ * Futex wait and wake on a word of the shared segment
+ */
+ static inline void
+ futexWait(uint32_t *word, uint32_t value)
+ {
+	syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+ }
 
- } MatrixData;
+ static inline void
+ futexWake(uint32_t *word, int n)
+ {
+	syscall(SYS_futex, word, FUTEX_WAKE, n, NULL, NULL, 0);
+ }
+
+/**
+ * Wait while *word is value, sleeping on the futex after announcing
+ * the caller in *waiters.
+ */
+ static inline void
+ waitWord(uint32_t *word, uint32_t value, uint32_t *waiters)
+ {
+	while(__atomic_load_n(word, __ATOMIC_ACQUIRE) == value)
+	{
+		__atomic_fetch_add(waiters, 1, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(word, __ATOMIC_SEQ_CST) == value)
+		{
+			futexWait(word, value);
+		}
+		__atomic_fetch_sub(waiters, 1, __ATOMIC_SEQ_CST);
+	}
+ }
+
+/**
+ * Bump *word, waking up to n of its waiters if there are any
+ */
+ static inline void
+ bumpWord(uint32_t *word, uint32_t *waiters, int n)
+ {
+	__atomic_fetch_add(word, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(waiters, __ATOMIC_SEQ_CST) > 0)
+	{
+		futexWake(word, n);
+	}
+ }
+
+/**
+ * Submit slot to the daemon.
+ * At most nSlots requests are ever queued, and the queue is at least
+ * that long, so a reserved cell is always free.
+ */
+ static inline void
+ submitSlot(ShmHeader *header, int slot)
+ {
+	uint32_t position = __atomic_fetch_add(&header -> submitTail, 1, __ATOMIC_RELAXED);
+	SubmitCell *cell = &header -> submitCells[position & header -> submitMask];
+	cell -> slot = slot;
+	__atomic_store_n(&cell -> seq, position + 1, __ATOMIC_RELEASE);
+	bumpWord(&header -> submitted, &header -> daemonWaiting, 1);
+ }
+
+/**
+ * Set *bytes to the bytes of a slot's data segment holding a request of
+ * a[n1][n2] * b[n2][n3].
+ * Return 0, or EOVERFLOW if they don't fit in maxDataSize.
+ */
+ static inline int
+ slotBytes(int n1, int n2, int n3, long maxDataSize, long *bytes)
+ {
+	long ab, bc, ac, n;
+	if(__builtin_mul_overflow((long) n1, (long) n2, &ab) ||
+	   __builtin_mul_overflow((long) n2, (long) n3, &bc) ||
+	   __builtin_mul_overflow((long) n1, (long) n3, &ac) ||
+	   __builtin_add_overflow(ab, bc, &n) ||
+	   __builtin_add_overflow(n, ac, &n) ||
+	   __builtin_mul_overflow(n, (long) sizeof(MatrixBaseType), &n) ||
+	   n > maxDataSize)
+	{
+		return EOVERFLOW;
+	}
+	*bytes = n;
+	return 0;
+ }
+
+/**
+ * Set name to the name of the data segment of slot i
+ */
+ static inline void
+ slotShmName(char name[SLOT_SHM_NAME_MAX], int i)
+ {
+	snprintf(name, SLOT_SHM_NAME_MAX, SLOT_SHM_NAME_FORMAT, i);
+ }
 
 #endif //ifndef _COMMON_H
@@ -0,0 +1,43 @@
+#ifndef _MATMUL_WAIT_H
+#define _MATMUL_WAIT_H
+
+/**
+ * How a client waits for the server to complete its requests.
+ * The mode of a client starts as given by the MATMUL_WAIT environment
+ * variable (block, spin or adaptive), adaptive if it is not set.
+ */
+#include "matmul.h"
+
+
+ typedef enum {
+
+	/**
+	 * Sleep in the kernel until woken by the server
+	 */
+	MATMUL_WAIT_BLOCK,
+
+	/**
+	 * Spin on the completion word without ever sleeping.
+	 * Only sensible with a CPU to spare for every waiting client.
+	 */
+	MATMUL_WAIT_SPIN,
+
+	/**
+	 * Spin for a bounded interval, then sleep.  The interval follows
+	 * how long recent requests took: it grows while requests complete
+	 * during the spin or shortly after it and shrinks when the client
+	 * sleeps longer, so long jobs soon stop spinning.  Now and then a
+	 * wait spins for the longest interval, to notice when requests get
+	 * short again.  Same as MATMUL_WAIT_BLOCK on a single CPU.
+	 */
+	MATMUL_WAIT_ADAPTIVE,
+
+ } MatMulWait;
+
+
+/** Set how matMul waits for the completion of its requests.
+ */
+void
+setMatrixMulWait(MatrixMul *matMul, MatMulWait wait);
+
+#endif //ifndef _MATMUL_WAIT_H
@@ -0,0 +1,60 @@
+#ifndef _MATMUL_ZERO_COPY_H
+#define _MATMUL_ZERO_COPY_H
+
+/**
+ * Zero-copy client API.
+ * Instead of passing a, b and c to mulMatrixMul(), which copies them
+ * into and out of the shared memory segment, the caller claims a slot of
+ * the segment, builds A and B in place, runs the request and reads C in
+ * place:
+ *
+ *	MatrixBaseType *a, *b, *c;
+ *	MatrixMulRequest *request = beginMatrixMulRequest(matMul, n1, n2, n3, &a, &b, &c, &err);
+ *	MatrixBaseType (*A)[n2] = (void *) a;	// fill A[n1][n2] and B[n2][n3]
+ *	runMatrixMulRequest(matMul, request, &err);
+ *	MatrixBaseType (*C)[n3] = (void *) c;	// read C[n1][n3]
+ *	endMatrixMulRequest(matMul, request, &err);
+ */
+#include "matmul.h"
+
+
+/**
+ * A claimed slot of the shared memory segment
+ */
+ typedef struct MatrixMulRequest MatrixMulRequest;
+
+
+/** Claim a slot for a request of a[n1][n2] * b[n2][n3], waiting for
+ *  one to be free, and set *a, *b and *c to the row-major A, B and C
+ *  matrices in the slot.  The server grows the slot's data segment
+ *  first if the request doesn't fit it.
+ *
+ *  Return NULL and set *err to EOVERFLOW if the matrices are larger
+ *  than the server's largest data segment, or to an appropriate error
+ *  number if the segment cannot be grown or mapped.
+ */
+MatrixMulRequest *
+beginMatrixMulRequest(const MatrixMul *matMul, int n1, int n2, int n3,
+		      MatrixBaseType **a, MatrixBaseType **b, MatrixBaseType **c, int *err);
+
+/** Run request and wait for C to be computed.  A and B may be rewritten
+ *  and the request run again.
+ *
+ *  Set *err to EINVAL if request has ended, or to the error number of the
+ *  server on error.
+ */
+void
+runMatrixMulRequest(const MatrixMul *matMul, MatrixMulRequest *request, int *err);
+
+/** Release the slot of request.  The pointers set by
+ *  beginMatrixMulRequest() are invalid afterwards.
+ *
+ *  Set *err to EINVAL if request is NULL or has ended already.  A request
+ *  never releases or runs a slot claimed after it ended, by this or any
+ *  other client; its handle is reused by the next request of matMul in
+ *  the same slot.
+ */
+void
+endMatrixMulRequest(const MatrixMul *matMul, MatrixMulRequest *request, int *err);
+
+#endif //ifndef _MATMUL_ZERO_COPY_H
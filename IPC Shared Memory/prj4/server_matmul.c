@@ -1,9 +1,14 @@
 
 /**
- * The source code includes iterative server design
+ * The source code includes concurrent server design
  * to handle client request. It does the work of multiplication of matrices.
- * It creates required semaphore for the synchronization and shared memory segment used to perform 
+ * It creates the shared memory segment used to perform 
  * matrix multiplication, the data sent by the client to server. 	
+ * The segment is divided into request slots, submitted by the clients through
+ * a lock-free queue in the segment header.  The matrices of each slot live in
+ * a data segment of its own, grown on request.
+ * The product of each request is split into blocks of C computed in parallel
+ * by a pool of compute threads.
  */
 
 /**
@@ -16,7 +21,6 @@
 /**
  * custom header files
  */
-#include <semaphore.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdio.h>
@@ -28,6 +32,8 @@
 #include <sys/types.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <limits.h>
 
 /**
 * Server Error handling for Shared Memory
@@ -40,50 +46,27 @@ int errNo = 0;
 FILE *filp = NULL; 
 
 /**
- * Initialization of semaphore IPC objects.
+ * Data segment of a slot, as mapped by the daemon
  */
+ typedef struct SlotData {
 
-static SemOpenArgsServer semArgs[] = {
-
-	{ 
-		.posixName = SERVER_SEM_NAME,
-		.oflags = O_RDWR|O_CREAT,
-		.mode = ALL_RW_PERMS,
-		.initValue = 1,
-	},
-
-	{ 
-		.posixName = REQUEST_SEM_NAME,
-		.oflags = O_RDWR|O_CREAT,
-		.mode = ALL_RW_PERMS,
-		.initValue = 0,
-	},
-
-	{ 
-		.posixName = RESPONSE_SEM_NAME,
-		.oflags = O_RDWR|O_CREAT,
-		.mode = ALL_RW_PERMS,
-		.initValue = 0,
-	},
-};
+	int fd;
+	MatrixBaseType *data;
+	long size;
+
+ } SlotData;
+
+/**
+ * Data segments of the slots
+ */
+static SlotData *slotData = NULL;
 
 /** 
  * Free resources on an error
  * Cleanup work for server errors 
  */
- void cleanUpMemory(int fd)
+ void cleanUpMemory(int fd, int nSlots)
  {
-	/**
-	 * Remvoe file 
-	 */
-	 int fileRet = remove(MEM_SIZE_SHARED_FILE);
-	 if(fileRet != 0)
-	 {
-		fprintf(filp, "cleanUpMemory() : Cannot remove file\n");
-		fflush(filp);
-	 }
-	
-	
 	/**
 	 * Close file descriptor
 	 */
@@ -104,57 +87,563 @@ static SemOpenArgsServer semArgs[] = {
 		fflush(filp);
 	}
 
+	/**
+	 * Remove the data segments of the slots
+	 */
+	for(int i = 0; i < nSlots; i++)
+	{
+		char name[SLOT_SHM_NAME_MAX];
+		slotShmName(name, i);
+		shm_unlink(name);
+	}
+
  }
 
- /**
-  * Cleanup semaphores
-  */
- void cleanUpResources()
- {
+
+/**
+ * Block sizes of the kernel.
+ * C is computed in blocks of BLOCK_ROWS x BLOCK_COLS, accumulated over
+ * panels of BLOCK_DEPTH rows of B so that the panel stays in cache.
+ */
+ #define BLOCK_ROWS 32
+ #define BLOCK_COLS 256
+ #define BLOCK_DEPTH 128
+
+/**
+ * Work, in multiply-adds plus stores of C, below which a request is
+ * computed by the dispatcher itself rather than woken compute threads.
+ */
+ #define INLINE_WORK (64L * 64 * 64)
+
+/**
+ * Multiplication job.
+ * A request's C split into blocks, handed out to the compute threads
+ * one block at a time.  A C of a single block is split along k instead:
+ * block p sums kDepth rows of B from p * kDepth on, block 0 into C and the
+ * others into their own tile of partials, which the last block adds to C.
+ */
+ typedef struct MulJob {
+
+	int n1;
+	int n2;
+	int n3;
+	const MatrixBaseType *A;
+	const MatrixBaseType *B;
+	MatrixBaseType *C;
+
+	int nBlockCols;
+	int nKParts;		// blocks per tile of C
+	int kDepth;		// rows of B summed by a block
+	MatrixBaseType *partials;	// nKParts - 1 partial tiles, or NULL
+	int nBlocks;
+	int nextBlock;		// first block not yet handed out
+	int nDone;		// blocks computed
+	MatrixSlot *slot;	// slot completed once nDone reaches nBlocks
+	struct MulJob *next;
+
+ } MulJob;
+
+/**
+ * Compute thread pool.
+ * Jobs with blocks left to hand out, oldest first.
+ * Only the daemon's threads use it, so it uses ordinary pthread locking.
+ */
+ typedef struct ComputePool {
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	MulJob *head;
+	MulJob *tail;
+	int nThreads;
+
+ } ComputePool;
+
+static ComputePool computePool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * Per-thread workspace for packed panels of B.
+ * Allocated on first use and kept for the life of the thread.
+ */
+static __thread MatrixBaseType *packedB = NULL;
+
+/**
+ * Compute block number block of job's C with the cache-blocked kernel.
+ * A, B and C are read and written in place in the mapped segment.  When
+ * C is wider than a block, the rows of a panel of B are far apart, so the
+ * panel is first packed into the thread's workspace.
+ */
+static void
+multiplyBlock(const MulJob *job, int block)
+{
+	int n2 = job -> n2;
+	int n3 = job -> n3;
+	int tile = block / job -> nKParts;
+	int part = block % job -> nKParts;
+	int iBegin = (tile / job -> nBlockCols) * BLOCK_ROWS;
+	int jBegin = (tile % job -> nBlockCols) * BLOCK_COLS;
+	int iEnd = (iBegin + BLOCK_ROWS < job -> n1) ? iBegin + BLOCK_ROWS : job -> n1;
+	int jEnd = (jBegin + BLOCK_COLS < n3) ? jBegin + BLOCK_COLS : n3;
+	int width = jEnd - jBegin;
+	int kFirst = part * job -> kDepth;
+	int kLast = ((long) kFirst + job -> kDepth < n2) ? kFirst + job -> kDepth : n2;
 
 	/**
-         * Unlink semaphores
-         */
-        sem_unlink(SERVER_SEM_NAME);
-        sem_unlink(REQUEST_SEM_NAME);
-        sem_unlink(RESPONSE_SEM_NAME);
+	 * Tile of C or of partials summed into, ldc elements per row
+	 */
+	MatrixBaseType *c = job -> C + (long) iBegin*n3 + jBegin;
+	long ldc = n3;
+	if(part > 0) {
+		c = job -> partials + (long) (part - 1)*BLOCK_ROWS*BLOCK_COLS;
+		ldc = width;
+	}
 
- }
+	if(job -> nBlockCols > 1 && packedB == NULL)
+	{
+		packedB = malloc(BLOCK_DEPTH * BLOCK_COLS * sizeof(MatrixBaseType));
+	}
+	_Bool pack = (job -> nBlockCols > 1 && packedB != NULL);
+
+	for(int i = 0; i < iEnd - iBegin; i++)
+		for(int j = 0; j < width; j++)
+			c[i*ldc + j] = 0;
+
+	for(int kBegin = kFirst; kBegin < kLast; kBegin += BLOCK_DEPTH) {
+		int kEnd = (kBegin + BLOCK_DEPTH < kLast) ? kBegin + BLOCK_DEPTH : kLast;
+
+		/**
+		 * Panel B[kBegin..kEnd][jBegin..jEnd], ldb elements per row
+		 */
+		const MatrixBaseType *panel = job -> B + (long) kBegin*n3 + jBegin;
+		long ldb = n3;
+		if(pack) {
+			for(int k = kBegin; k < kEnd; k++)
+				memcpy(packedB + (long) (k - kBegin)*width, panel + (long) (k - kBegin)*n3, width * sizeof(MatrixBaseType));
+			panel = packedB;
+			ldb = width;
+		}
 
+		for(int i = iBegin; i < iEnd; i++) {
+			MatrixBaseType *cRow = c + (i - iBegin)*ldc;
+			for(int k = kBegin; k < kEnd; k++) {
+				MatrixBaseType a = job -> A[(long) i*n2 + k];
+				const MatrixBaseType *bRow = panel + (k - kBegin)*ldb;
+				for(int j = 0; j < width; j++)
+					cRow[j] += a * bRow[j];
+			}
+		}
+	}
+}
 
 /**
- * Daemon Service.
- * Used to do matrix multiplication, the request which is sent by the client.
+ * Take the next block of job, or of the oldest job if job is NULL.
+ * Return the block and set *blockJob to its job, or return -1 if there
+ * is none.  Called with the pool lock held.
+ */
+static int
+takeBlock(MulJob *job, MulJob **blockJob)
+{
+	job = (job != NULL) ? job : computePool.head;
+	if(job == NULL || job -> nextBlock == job -> nBlocks)
+	{
+		return -1;
+	}
+	int block = job -> nextBlock++;
+
+	/**
+	 * Unlink the job once its last block is handed out
+	 */
+	if(job -> nextBlock == job -> nBlocks)
+	{
+		MulJob **link = &computePool.head;
+		MulJob *prev = NULL;
+		while(*link != job)
+		{
+			prev = *link;
+			link = &(*link) -> next;
+		}
+		*link = job -> next;
+		if(computePool.tail == job)
+		{
+			computePool.tail = prev;
+		}
+	}
+	*blockJob = job;
+	return block;
+}
+
+/**
+ * Record a computed block of job and return true if it was the last one.
+ * Called with the pool lock held.
+ */
+static _Bool
+finishBlock(MulJob *job)
+{
+	return ++job -> nDone == job -> nBlocks;
+}
+
+/**
+ * Report the request of slot as completed to its client
+ */
+static void
+completeSlot(MatrixSlot *slot)
+{
+	bumpWord(&slot -> doneSeq, &slot -> doneWaiters, 1);
+}
+
+/**
+ * Complete job once all its blocks are computed, first adding the
+ * partial tiles of a job split along k to C.
+ */
+static void
+finishJob(MulJob *job)
+{
+	if(job -> partials != NULL)
+	{
+		int n3 = job -> n3;
+		for(int part = 1; part < job -> nKParts; part++)
+		{
+			const MatrixBaseType *partial = job -> partials + (long) (part - 1)*BLOCK_ROWS*BLOCK_COLS;
+			for(int i = 0; i < job -> n1; i++)
+				for(int j = 0; j < n3; j++)
+					job -> C[(long) i*n3 + j] += partial[i*n3 + j];
+		}
+		free(job -> partials);
+		job -> partials = NULL;
+	}
+	completeSlot(job -> slot);
+}
+
+/**
+ * Compute Thread.
+ * Computes blocks of the queued jobs, oldest job first.
+ */
+static void *
+computeThread(void *arg)
+{
+	(void) arg;
+	pthread_mutex_lock(&computePool.lock);
+	while(1)
+	{
+		MulJob *job;
+		int block = takeBlock(NULL, &job);
+		if(block < 0)
+		{
+			pthread_cond_wait(&computePool.work, &computePool.lock);
+			continue;
+		}
+		pthread_mutex_unlock(&computePool.lock);
+		multiplyBlock(job, block);
+		pthread_mutex_lock(&computePool.lock);
+		if(finishBlock(job))
+		{
+			pthread_mutex_unlock(&computePool.lock);
+			finishJob(job);
+			pthread_mutex_lock(&computePool.lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Start the nThreads compute threads.
  */
+static int
+startComputePool(int nThreads)
+{
+	computePool.nThreads = nThreads;
+	for(int i = 0; i < nThreads; i++)
+	{
+		pthread_t thread;
+		int err = pthread_create(&thread, NULL, computeThread, NULL);
+		if(err != 0)
+		{
+			return err;
+		}
+		pthread_detach(thread);
+	}
+	return 0;
+}
 
+/**
+ * Start job.
+ * It is queued to the compute pool, whose thread computing the last
+ * block completes the slot, so the dispatcher goes on starting the other
+ * clients' requests.  Only requests of less than INLINE_WORK are not
+ * worth waking the pool and are computed and completed right away.  A
+ * request with more blocks than the pool can count is rejected with
+ * EOVERFLOW.
+ */
 static void
-doDaemonService(long shmMemSize)
+startJob(MulJob *job)
 {
+	long nBlockCols = ((long) job -> n3 + BLOCK_COLS - 1) / BLOCK_COLS;
+	long nBlocks = (((long) job -> n1 + BLOCK_ROWS - 1) / BLOCK_ROWS) * nBlockCols;
+	if(nBlocks > INT_MAX)
+	{
+		job -> slot -> matrixData.err = EOVERFLOW;
+		completeSlot(job -> slot);
+		return;
+	}
+	job -> nBlockCols = nBlockCols;
+	job -> nKParts = 1;
+	job -> kDepth = job -> n2;
+	job -> partials = NULL;
+	job -> nBlocks = nBlocks;
+	job -> nextBlock = 0;
+	job -> nDone = 0;
+	job -> next = NULL;
+
+	long work;
+	if(!__builtin_mul_overflow((long) job -> n1 * job -> n3, (long) job -> n2 + 1, &work) &&
+	   work < INLINE_WORK)
+	{
+		for(int block = 0; block < job -> nBlocks; block++)
+		{
+			multiplyBlock(job, block);
+		}
+		completeSlot(job -> slot);
+		return;
+	}
+
 	/**
-	 *
+	 * A single block would keep one compute thread busy and leave the
+	 * others idle: split it along k, in multiples of BLOCK_DEPTH
 	 */
-	 int err = 0;
+	if(job -> nBlocks == 1 && computePool.nThreads > 1 && job -> n2 > BLOCK_DEPTH)
+	{
+		int nPanels = ((long) job -> n2 + BLOCK_DEPTH - 1) / BLOCK_DEPTH;
+		int nKParts = (nPanels < computePool.nThreads) ? nPanels : computePool.nThreads;
+		int kDepth = ((nPanels + nKParts - 1) / nKParts) * BLOCK_DEPTH;
+		nKParts = ((long) job -> n2 + kDepth - 1) / kDepth;
+		MatrixBaseType *partials = malloc((long) (nKParts - 1)*BLOCK_ROWS*BLOCK_COLS*sizeof(MatrixBaseType));
+		if(partials != NULL)
+		{
+			job -> nKParts = nKParts;
+			job -> kDepth = kDepth;
+			job -> partials = partials;
+			job -> nBlocks = nKParts;
+		}
+	}
 
+	pthread_mutex_lock(&computePool.lock);
+	if(computePool.tail != NULL)
+	{
+		computePool.tail -> next = job;
+	}
+	else
+	{
+		computePool.head = job;
+	}
+	computePool.tail = job;
+	pthread_cond_broadcast(&computePool.work);
+	pthread_mutex_unlock(&computePool.lock);
+}
+
+/**
+ * Size data segment i to size bytes and map it.
+ * Return 0 or an error number.
+ */
+static int
+mapSlotData(int i, long size)
+{
+	SlotData *data = &slotData[i];
+	if(ftruncate(data -> fd, size) < 0)
+	{
+		return errno;
+	}
+	MatrixBaseType *mapped = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, data -> fd, 0);
+	if(mapped == MAP_FAILED)
+	{
+		return errno;
+	}
+	if(data -> data != NULL)
+	{
+		munmap(data -> data, data -> size);
+	}
+	data -> data = mapped;
+	data -> size = size;
+	return 0;
+}
+
+/**
+ * Grow the data segment of slot i to hold at least need bytes, need being
+ * at most maxDataSize.
+ * It at least doubles, up to maxDataSize, so a client growing its requests
+ * step by step only asks a few times.  The slot is owned by the requesting
+ * client and has no request in flight, so the segment can be remapped.
+ */
+static int
+resizeSlot(MatrixSlot *slot, int i, long need, long maxDataSize)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	long size = (need > 2 * slotData[i].size) ? need : 2 * slotData[i].size;
+	size = ((size + pageSize - 1) / pageSize) * pageSize;
+	size = (size > maxDataSize) ? maxDataSize : size;
+	int err = mapSlotData(i, size);
+	if(err != 0)
+	{
+		fprintf(filp, "resizeSlot() : Cannot grow slot %d to %ld, %s\n", i, size, strerror(err));
+		fflush(filp);
+		return err;
+	}
+	__atomic_store_n(&slot -> dataSize, size, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * Start the request of slot i.
+ * C is stored after A and B, and computed directly from them
+ * in the slot's data segment.  job is the slot's own, free since a slot
+ * holds one request at a time.
+ */
+static void
+startRequest(MatrixSlot *slot, int i, MulJob *job, long maxDataSize)
+{
+	MatrixData *matrixData = &slot -> matrixData;
+	int n1 = matrixData -> n1;
+	int n2 = matrixData -> n2;
+	int n3 = matrixData -> n3;		
+
+	/**
+	 * Reject negative dimensions
+	 */
+	if(n1 < 0 || n2 < 0 || n3 < 0)
+	{
+		matrixData -> err = EINVAL;
+		completeSlot(slot);
+		return;
+	}
+
+	/**
+	 * Reject dimensions whose matrices would overflow the largest
+	 * data segment
+	 */
+	long need = 0;
+	int err = slotBytes(n1, n2, n3, maxDataSize, &need);
+	if(err != 0)
+	{
+		matrixData -> err = err;
+		completeSlot(slot);
+		return;
+	}
 
 	/**
-	 * Communicate from server to client error handling mechanism 
+	 * Grow the data segment on request
 	 */
-	int mapErr = 0;	
+	if(slot -> op == SLOT_RESIZE)
+	{
+		matrixData -> err = (need > slotData[i].size) ? resizeSlot(slot, i, need, maxDataSize) : 0;
+		completeSlot(slot);
+		return;
+	}
+
+	/**
+	 * Reject dimensions which don't fit the data segment
+	 */
+	if(need > slotData[i].size)
+	{
+		matrixData -> err = EOVERFLOW;
+		completeSlot(slot);
+		return;
+	}
 
 	/**
-	 *  Initialize the semaphore IPC object on the server side  
-	 */	
-	sem_t *sems[N_SEMS];
-	for (int i = 0; i < N_SEMS; i++) 
-	{ 
-		const SemOpenArgsServer *p = &semArgs[i];
-		if ((sems[i] = sem_open(p->posixName, p->oflags, p->mode, p->initValue)) == NULL)
+	 * Matrix A, B and C in the data segment
+	 */
+	MatrixBaseType *A = slotData[i].data;
+	*job = (MulJob) {
+		.n1 = n1,
+		.n2 = n2,
+		.n3 = n3,
+		.A = A,
+		.B = A + (long) n1*n2,
+		.C = A + (long) n1*n2 + (long) n2*n3,
+		.slot = slot,
+	};
+
+	/**
+	 * Matrix Multiplication 
+	 */
+	startJob(job);
+}
+
+/**
+ * Dispatch Requests.
+ * Consume the submission queue in order and start every submitted
+ * request, sleeping on the queue's futex when it is empty.
+ */
+static void
+dispatchRequests(ShmHeader *header, MulJob *jobs)
+{
+	uint32_t head = 0;
+	while(1)
+	{
+		SubmitCell *cell = &header -> submitCells[head & header -> submitMask];
+		uint32_t submitted = __atomic_load_n(&header -> submitted, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&cell -> seq, __ATOMIC_ACQUIRE) != head + 1)
 		{
-			err = EIO;	
-			fprintf(filp, "doDeamonService() : Cannot create semaphore %s %s\n", p -> posixName, strerror(err));
+			waitWord(&header -> submitted, submitted, &header -> daemonWaiting);
+			continue;
+		}
+		int i = cell -> slot;
+		head++;
+
+		if(i < 0 || i >= header -> nSlots)
+		{
+			fprintf(filp, "dispatchRequests() : Bad slot %d submitted\n", i);
 			fflush(filp);
+			continue;
 		}
+		startRequest(shmSlot(header, i), i, &jobs[i], header -> maxDataSize);
 	}
+}
+
+/**
+ * Daemon Service.
+ * Used to do matrix multiplication, the request which is sent by the client.
+ * The shared memory segment is laid out as nSlots request slots.  Clients
+ * submit their slot through the queue in the segment header and the daemon
+ * starts the requests in order, so clients don't wait on each other.
+ * dataMemSize is shared evenly by the initial data segments of the slots.
+ */
+
+static void
+doDaemonService(long dataMemSize, int nSlots, int nThreads)
+{
+	/**
+	 *
+	 */
+	 int err = 0;
+
+	/**
+	 * Submission queue length, a power of two of at least nSlots
+	 */
+	uint32_t queueLength = 1;
+	while(queueLength < (uint32_t) nSlots)
+	{
+		queueLength *= 2;
+	}
+
+	/**
+	 * Offset of the slots, after the header and its queue, size of each
+	 * slot and of the segment
+	 */
+	long slotsOffset = sizeof(ShmHeader) + queueLength * sizeof(SubmitCell);
+	slotsOffset = ((slotsOffset + SLOT_ALIGN - 1) / SLOT_ALIGN) * SLOT_ALIGN;
+	long slotSize = ((sizeof(MatrixSlot) + SLOT_ALIGN - 1) / SLOT_ALIGN) * SLOT_ALIGN;
+	long shmMemSize = slotsOffset + nSlots * slotSize;
+
+	/**
+	 * Initial size of each data segment, at least a page and at most
+	 * the largest data segment
+	 */
+	long pageSize = sysconf(_SC_PAGESIZE);
+	long dataSize = ((dataMemSize / nSlots + pageSize - 1) / pageSize) * pageSize;
+	dataSize = (dataSize < pageSize) ? pageSize : dataSize;
+	dataSize = (dataSize > MAX_SLOT_DATA_SIZE) ? MAX_SLOT_DATA_SIZE : dataSize;
 
 	/** 
 	 * Shared memory segment
@@ -174,146 +663,101 @@ doDaemonService(long shmMemSize)
 	if(ftruncate(fd, shmMemSize) < 0)
 	{
 		err = EPERM;
-		cleanUpMemory(fd);
-		cleanUpResources();
+		cleanUpMemory(fd, nSlots);
 		fprintf(filp, "doDeamonService() : Cannot Size shm %s to %ld, %s\n", SHM_NAME, shmMemSize, strerror(err));	
 		fflush(filp);
+		exit(EXIT_FAILURE);
 	}
 
 	/**
-	 * Matrix Data mapped into the memory
+	 * Segment header mapped into the memory
 	 */
-	MatrixData *matrixData = NULL;
-	if((matrixData = mmap(NULL, shmMemSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) 
+	ShmHeader *header = NULL;
+	if((header = mmap(NULL, shmMemSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) 
 	{
 		err = ENOMEM;
-		cleanUpMemory(fd);
-                cleanUpResources();
+		cleanUpMemory(fd, nSlots);
 		fprintf(filp, "doDeamonService() : Mapped Allocation Error %s\n", strerror(err));
 		fflush(filp);
+		exit(EXIT_FAILURE);
 	}
+	header -> nSlots = nSlots;
+	header -> slotSize = slotSize;
+	header -> slotsOffset = slotsOffset;
+	header -> shmSize = shmMemSize;
+	header -> maxDataSize = MAX_SLOT_DATA_SIZE;
+	header -> submitMask = queueLength - 1;
 
-
-	/**
-         * Write memory size to the file so client can read the memory size
-         */
-        FILE *fp = NULL;
-        fp = fopen(MEM_SIZE_SHARED_FILE, "w+");
-        if(fp == NULL)
-        {
-            err = ENOENT;
-            fprintf(filp, "makeDaemon() : Cannot open file for writing %s\n", strerror(err));
-            fflush(filp);
-        }
-
-        /**
-         * Write memory size to the file
-         */
-        fprintf(fp, "%ld", shmMemSize);
-        fflush(fp);
-
-        /**
-         * Close the resource
-         */
-        fclose(fp);
-
-	
 	/**
-	 * Wait for client request
+	 * Data segments of the slots.
+	 * The segment's exclusive creation above already makes them ours.
 	 */
-	while(1)
+	slotData = calloc(nSlots, sizeof(SlotData));
+	if(slotData == NULL)
 	{
-
-		/**
-		 * Wait for the client request 
-		 */
-		if(sem_wait(sems[REQUEST_SEM]) < 0) 
+		err = ENOMEM;
+		cleanUpMemory(fd, nSlots);
+		fprintf(filp, "doDeamonService() : Cannot allocate slot data %s\n", strerror(err));
+		fflush(filp);
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < nSlots; i++)
+	{
+		char name[SLOT_SHM_NAME_MAX];
+		slotShmName(name, i);
+		if((slotData[i].fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, ALL_RW_PERMS)) < 0 ||
+		   (err = mapSlotData(i, dataSize)) != 0)
 		{
-			mapErr = EIO;
-			matrixData -> err = mapErr;	
-			munmap(matrixData, shmMemSize);		
-			cleanUpMemory(fd);
-	                cleanUpResources();	
-			fprintf(filp, "doDeamonService() : Wait error on sem %s, %s\n", REQUEST_SEM_NAME, strerror(mapErr));
+			err = (err != 0) ? err : errno;
+			cleanUpMemory(fd, nSlots);
+			fprintf(filp, "doDeamonService() : Cannot create slot data %s, %s\n", name, strerror(err));
 			fflush(filp);
+			exit(EXIT_FAILURE);
 		}
+		shmSlot(header, i) -> dataSize = dataSize;
+	}
 
-		// Code For Matrix Multiplication
-
-		int n1 = matrixData -> n1;
-		int n2 = matrixData -> n2;
-		int n3 = matrixData -> n3;		
-
-		/** 
-		 * Store final matrix data
-		 */ 
-		int sum = 0;
-
-		/**
-		 * Temporary array for Matrix A and Matrix B to compute result matrix data
-		 */
-		MatrixBaseType A[n1][n2];
-		MatrixBaseType B[n2][n3];
-
-
-		/**
-	 	 * Matrix A Data
-	 	 */
-		for(int i = 0; i < n1; i++) 
-			for(int j = 0; j < n2; j++) 
-				A[i][j] = *(&matrixData -> ABCMatrices + i*n2 + j);
-
-		/**
-		 * Matrix B offset
-		 */
-		int BOffset = n1*n2;	
+	/**
+	 * Jobs of the slots, private to the daemon
+	 */
+	MulJob *jobs = calloc(nSlots, sizeof(MulJob));
+	if(jobs == NULL)
+	{
+		err = ENOMEM;
+		cleanUpMemory(fd, nSlots);
+		fprintf(filp, "doDeamonService() : Cannot allocate jobs %s\n", strerror(err));
+		fflush(filp);
+		exit(EXIT_FAILURE);
+	}
 
-		/**
-		 * Matrix B Data
-		 */
-		for(int i = 0; i < n2; i++)
-			for(int j = 0; j < n3; j++)
-				B[i][j] = *(&matrixData -> ABCMatrices + BOffset + i*n3 + j);
+	/**
+	 * Start the compute threads shared by the slots
+	 */
+	if((err = startComputePool(nThreads)) != 0)
+	{
+		cleanUpMemory(fd, nSlots);
+		fprintf(filp, "doDeamonService() : Cannot start compute threads, %s\n", strerror(err));
+		fflush(filp);
+		exit(EXIT_FAILURE);
+	}
 
-		/**
-		 * Matrix C offset
-		 */
-		int COffset = BOffset + n1*n3;
+	/**
+	 * Open the segment to the clients, which take its size from the
+	 * header once it is ready
+	 */
+	__atomic_store_n(&header -> ready, SHM_READY, __ATOMIC_RELEASE);
 
-		/**
-		 * Matrix Multiplication 
-		 */
-		for(int i = 0; i < n1; i++) {
-			for (int j = 0; j < n3; j++) {
-				for (int k = 0; k < n2; k++) {
-					sum += A[i][k] * B[k][j];
-				}
-				*(&matrixData -> ABCMatrices + COffset + i*n3 + j) = sum;
-				sum = 0;	 
-			}
-		}
+	fprintf(filp, "Serving %d slots of %ld bytes with %d compute threads\n", nSlots, dataSize, nThreads);
+	fflush(filp);
 
-		/**
-		 * Signal client to store the response
-		 */
-		if(sem_post(sems[RESPONSE_SEM]) < 0) 
-		{
-			mapErr = EIO;
-			matrixData -> err = mapErr;
-			munmap(matrixData, shmMemSize);
-                        cleanUpMemory(fd);
-                        cleanUpResources();
-			fprintf(filp, "Cannot post sem %s, %s\n", RESPONSE_SEM_NAME, strerror(mapErr));
-			fflush(filp);
-		}	
-	}	
+	dispatchRequests(header, jobs);
 }
 
 /**
  * Function is used to create a daemon service
  */
 static pid_t 
-makeDaemon(long shmMemSize)
+makeDaemon(long shmMemSize, int nSlots, int nThreads)
 {
 	pid_t processId, sId;
 	int err = 0;
@@ -348,7 +792,7 @@ makeDaemon(long shmMemSize)
         fprintf(filp, "Daemon Started With PID : %d\n", getpid());
         fflush(filp);
 
-	doDaemonService(shmMemSize);	
+	doDaemonService(shmMemSize, nSlots, nThreads);	
 	assert(0);
 
 }
@@ -357,9 +801,9 @@ makeDaemon(long shmMemSize)
   * Function is send to create background service to serve multiple client request
   */
 static pid_t
-makeServer(long shmMemSize)
+makeServer(long shmMemSize, int nSlots, int nThreads)
 {
-	return makeDaemon(shmMemSize);
+	return makeDaemon(shmMemSize, nSlots, nThreads);
 }
 
 /**
@@ -378,29 +822,37 @@ checkValidInput(const char *input)
 
 int main(int argc, const char *argv[])
 {
-	if(argc != 2) fatal("usage: %s <shm-size-kib>", argv[0]);
+	if(argc < 2 || argc > 4) fatal("usage: %s <shm-size-kib> [<n-slots> [<n-threads>]]", argv[0]);
 	const char *inputMemSize = argv[1];
 	int status = checkValidInput(inputMemSize);
+	for(int i = 2; i < argc; i++)
+		if(checkValidInput(argv[i]) == 0) status = 0;
 	
 	/**
 	 * Check for numbers only : Valid Input
 	 */
 	if(status == 0)
 	{
-	 	fatal("usage: %s <shm-size-kib>", argv[0]);
+	 	fatal("usage: %s <shm-size-kib> [<n-slots> [<n-threads>]]", argv[0]);
 	}
 
 	int shmMemSize = atoi(argv[1]);
-	if(shmMemSize < 0)
+	int nSlots = (argc >= 3) ? atoi(argv[2]) : DEFAULT_N_SLOTS;
+
+	/**
+	 * Compute threads, one per online CPU by default
+	 */
+	int nThreads = (argc >= 4) ? atoi(argv[3]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if(shmMemSize < 0 || nSlots < 1 || nThreads < 1)
 	{
-		fatal("usage: %s <shm-size-kib>", argv[0]);
+		fatal("usage: %s <shm-size-kib> [<n-slots> [<n-threads>]]", argv[0]);
 	}
 
 	/**
 	 * Convert the number into bytes
 	 */
-	long shmMemSizeInBytes = shmMemSize * 1024;
-	pid_t pid = makeServer(shmMemSizeInBytes);
+	long shmMemSizeInBytes = (long) shmMemSize * 1024;
+	pid_t pid = makeServer(shmMemSizeInBytes, nSlots, nThreads);
 	printf("%ld\n", (long)pid);
 	return 0;
 }
@@ -1,4 +1,5 @@
 #include "abstract_matrix.h"
+#include "matrix_alloc.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -21,7 +22,7 @@ static void freeMatrix(Matrix *this, int *err)
 	}
 	else
 	{
-		free(this);					// standard system call			
+		freeMatrixStorage(this);			// release malloc'd or mmap'd storage
 	}
 }
 
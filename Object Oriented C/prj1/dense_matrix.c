@@ -1,5 +1,9 @@
 #include "abstract_matrix.h"
 #include "dense_matrix.h"
+#include "matrix_alloc.h"
+#include "matrix_kernels.h"
+#include "matrix_ops.h"
+#include "matrix_tune.h"
 
 #include <errno.h>
 #include <stdbool.h>
@@ -131,6 +135,48 @@ static void setElement(Matrix *this, int rowIndex, int colIndex, MatrixBaseType
 	}
 }
 
+static DenseMatrixFns denseMatrixFns;		// virtual table, defined below
+
+/** The function is used to transpose the given matrix.
+    When both matrices are dense matrices the elements are transposed
+    directly with the blocked kernel, using the tile size tuned for this
+    host.  Any other combination uses the abstract getElement/setElement
+    transpose.
+*/
+static void transpose(const Matrix *this, Matrix *result, int *err)
+{
+	if(this -> fns != (const MatrixFns *) &denseMatrixFns || result -> fns != this -> fns)
+	{
+		getAbstractMatrixFns() -> transpose(this, result, err);		// generic transpose
+		return;
+	}
+
+	const DenseMatrixImpl *denseMatrixImpl = (const DenseMatrixImpl *) this;	// cast to specific
+	DenseMatrixImpl *resultImpl = (DenseMatrixImpl *) result;			// cast to specific
+
+	if(denseMatrixImpl -> nRows != resultImpl -> nCols || denseMatrixImpl -> nCols != resultImpl -> nRows)
+	{
+		*err = EDOM;								// not compatible dimensions
+	}
+	else
+	{
+		transposeKernel(denseMatrixImpl -> element, denseMatrixImpl -> nRows, denseMatrixImpl -> nCols,
+				resultImpl -> element, getMatrixTuning() -> transposeTile);
+	}
+}
+
+/**
+   This function returns the row-major array holding the dense matrix entries,
+   which lets the element-wise operations of matrix_ops.h run directly on it.
+*/
+static MatrixBaseType *elements(const Matrix *this)
+{
+	const DenseMatrixImpl *denseMatrixImpl = (const DenseMatrixImpl *) this;	// cast to specific
+	return (MatrixBaseType *) denseMatrixImpl -> element;				// contiguous entries
+}
+
+static MatrixOpsFns denseMatrixOpsFns;			// element-wise operations, inherited in constructor
+
 /** Initializing Function Pointers to design OOP concept in C language. 
     This is equivalent to virtual table in C++.
     The basic abstract interfaces to be able to use by sub-classes and its sub-classes 
@@ -142,7 +188,8 @@ static DenseMatrixFns denseMatrixFns = {
         .getNRows   = getNRows,		// implemented above  - override	
         .getNCols   = getNCols,		// implemented above  - override
  	.getElement = getElement,	// implemented above  - override
-	.setElement = setElement	// implemented above  - override
+	.setElement = setElement,	// implemented above  - override
+	.transpose  = transpose		// implemented above  - override
 
 };
 
@@ -165,8 +212,10 @@ newDenseMatrix(int nRows, int nCols, int *err)
 		/**
 	   	  This memory allocation stores structure elements in a consecutive memory location.
 	   	  All elements are being stored contiguously.
+		  Large matrices are placed on 2 MB huge pages so that stride walks
+		  over the elements do not miss the TLB on every row.
 		*/
-		denseMatrix = (DenseMatrixImpl *) malloc(sizeof(DenseMatrixImpl) + nRows * nCols * sizeof(int));	// dynamic memory allocation
+		denseMatrix = (DenseMatrixImpl *) allocMatrixStorage(sizeof(DenseMatrixImpl) + (size_t) nRows * nCols * sizeof(int), err);	// dynamic memory allocation
 
 		if(!denseMatrix)		// check for enough memory allocation
 		{
@@ -178,9 +227,11 @@ newDenseMatrix(int nRows, int nCols, int *err)
 			if(!isInit)								// check init bool variable	
 			{
 				const MatrixFns *fns = getAbstractMatrixFns();			// get super class
-				denseMatrixFns.transpose = fns -> transpose;			// inherit super method transpose	
 				denseMatrixFns.mul = fns -> mul;				// inherit super method mul
 				denseMatrixFns.free = fns -> free;				// inherit super method free
+				denseMatrixOpsFns = *getAbstractMatrixOpsFns();			// inherit element-wise operations
+				denseMatrixOpsFns.elements = elements;				// override - contiguous storage
+				registerMatrixOpsFns((const MatrixFns *) &denseMatrixFns, &denseMatrixOpsFns);
 				isInit = true;							// one instance to exit for entire program
 			}	
 
@@ -189,10 +240,7 @@ newDenseMatrix(int nRows, int nCols, int *err)
 			denseMatrix -> nRows = nRows;						// allocate memory for rows
 			denseMatrix -> nCols = nCols;						// allocate memory for cols
 	
-			for(int counter = 0; counter < nRows * nCols; counter++)
-			{
-				denseMatrix -> element[counter] = counter;			// initialize to offset values
-			}
+			touchMatrixElements(denseMatrix -> element, (long) nRows * nCols);	// initialize to offset values
 		}
 	}
 	return (DenseMatrix *) denseMatrix;					// return new dense matrix	 	
@@ -0,0 +1,215 @@
+#include "matrix_alloc.h"
+#include "matrix_parallel.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/mman.h>
+
+/**
+ * Minimum number of elements touched by each thread of touchMatrixElements()
+ */
+#define TOUCH_CHUNK (1L << 20)
+
+/** Every allocation is preceded by a header recording how it was
+    obtained, so freeMatrixStorage() can undo it without the caller
+    having to remember the size.  The header is padded to a cache
+    line so the matrix object itself stays cache line aligned.
+*/
+typedef enum {
+	STORAGE_MALLOC,					// obtained from malloc()
+	STORAGE_MMAP					// obtained from mmap()
+} StorageKind;
+
+typedef union {
+	struct {
+		StorageKind kind;			// how storage was obtained
+		size_t mapLength;			// bytes mapped for STORAGE_MMAP
+	};
+	char pad[64];					// keep object cache line aligned
+} StorageHeader;
+
+static MatrixAllocStats allocStats;			// allocation counters
+
+/**
+   Map length bytes (a multiple of MATRIX_HUGE_PAGE_SIZE) at a 2 MB
+   aligned address.  Over-map by one huge page and trim the unaligned
+   head and tail so the kernel can back the region with huge pages.
+*/
+static void *mapAligned(size_t length)
+{
+	size_t overLength = length + MATRIX_HUGE_PAGE_SIZE;
+	char *p = mmap(NULL, overLength, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	uintptr_t addr = (uintptr_t) p;
+	uintptr_t aligned = (addr + MATRIX_HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (MATRIX_HUGE_PAGE_SIZE - 1);
+	size_t head = aligned - addr;
+	size_t tail = overLength - head - length;
+
+	if(head > 0)
+	{
+		munmap(p, head);				// trim unaligned head
+	}
+	if(tail > 0)
+	{
+		munmap((char *) aligned + length, tail);	// trim unaligned tail
+	}
+	return (void *) aligned;
+}
+
+/**
+   Return a 2 MB aligned region of length bytes backed by huge pages
+   if possible.  With MATRIX_USE_HUGETLB explicit huge pages are tried
+   first; otherwise (or if the hugetlbfs pool is empty) the region is
+   advised for transparent huge pages.
+*/
+static void *mapHuge(size_t length)
+{
+	void *p = NULL;
+
+#if defined(MATRIX_USE_HUGETLB) && defined(MAP_HUGETLB)
+	p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(p != MAP_FAILED)
+	{
+		__atomic_fetch_add(&allocStats.nHugeTlbAllocs, 1, __ATOMIC_RELAXED);
+		return p;
+	}
+#endif
+
+	p = mapAligned(length);
+	if(p == NULL)
+	{
+		return NULL;
+	}
+
+#ifdef MADV_HUGEPAGE
+	madvise(p, length, MADV_HUGEPAGE);			// advisory: failure is harmless
+#endif
+	return p;
+}
+
+/**
+   Return storage for a matrix object.  Small objects use malloc(),
+   large ones are huge page backed.
+*/
+void *allocMatrixStorage(size_t size, int *err)
+{
+	size_t total = sizeof(StorageHeader) + size;
+	StorageHeader *header = NULL;
+
+	if(total >= (size_t) MATRIX_HUGE_PAGE_THRESHOLD)
+	{
+		size_t mapLength = (total + MATRIX_HUGE_PAGE_SIZE - 1) & ~(size_t) (MATRIX_HUGE_PAGE_SIZE - 1);
+		header = mapHuge(mapLength);
+		if(header != NULL)
+		{
+			header -> kind = STORAGE_MMAP;
+			header -> mapLength = mapLength;
+			__atomic_fetch_add(&allocStats.nHugeAllocs, 1, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&allocStats.hugeBytes, mapLength, __ATOMIC_RELAXED);
+			return header + 1;
+		}
+		__atomic_fetch_add(&allocStats.nHugeFallbacks, 1, __ATOMIC_RELAXED);
+	}
+
+	header = malloc(total);
+	if(header == NULL)
+	{
+		*err = ENOMEM;					// set error code
+		return NULL;
+	}
+	header -> kind = STORAGE_MALLOC;
+	header -> mapLength = 0;
+	__atomic_fetch_add(&allocStats.nSmallAllocs, 1, __ATOMIC_RELAXED);
+	return header + 1;
+}
+
+/**
+   Release storage according to how it was obtained.
+*/
+void freeMatrixStorage(void *storage)
+{
+	if(storage == NULL)
+	{
+		return;
+	}
+
+	StorageHeader *header = (StorageHeader *) storage - 1;
+	if(header -> kind == STORAGE_MMAP)
+	{
+		__atomic_fetch_sub(&allocStats.hugeBytes, header -> mapLength, __ATOMIC_RELAXED);
+		munmap(header, header -> mapLength);
+	}
+	else
+	{
+		free(header);
+	}
+}
+
+/**
+   Loop body for touchMatrixElements(): initialize a range to offsets.
+*/
+static void touchRange(long lo, long hi, void *arg)
+{
+	int *element = arg;
+	for(long counter = lo; counter < hi; counter++)
+	{
+		element[counter] = (int) counter;		// initialize to offset values
+	}
+}
+
+/**
+   First-touch initialization.  On NUMA hosts pages end up local to the
+   thread which first writes them, and faulting in huge pages from
+   several threads hides most of the page clearing cost.
+*/
+void touchMatrixElements(int element[], long nElements)
+{
+	parallelFor(nElements, TOUCH_CHUNK, touchRange, element);
+}
+
+/**
+   Return AnonHugePages of this process in KiB, or -1 if the kernel
+   does not report it.
+*/
+static long readAnonHugeKib(void)
+{
+	FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+	if(fp == NULL)
+	{
+		return -1;
+	}
+
+	char line[128];
+	long kib = -1;
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if(sscanf(line, "AnonHugePages: %ld kB", &kib) == 1)
+		{
+			break;
+		}
+	}
+	fclose(fp);
+	return kib;
+}
+
+/**
+   Snapshot the allocation counters.
+*/
+void getMatrixAllocStats(MatrixAllocStats *stats)
+{
+	stats -> nSmallAllocs = __atomic_load_n(&allocStats.nSmallAllocs, __ATOMIC_RELAXED);
+	stats -> nHugeAllocs = __atomic_load_n(&allocStats.nHugeAllocs, __ATOMIC_RELAXED);
+	stats -> nHugeTlbAllocs = __atomic_load_n(&allocStats.nHugeTlbAllocs, __ATOMIC_RELAXED);
+	stats -> nHugeFallbacks = __atomic_load_n(&allocStats.nHugeFallbacks, __ATOMIC_RELAXED);
+	stats -> hugeBytes = __atomic_load_n(&allocStats.hugeBytes, __ATOMIC_RELAXED);
+	stats -> anonHugeKib = readAnonHugeKib();
+}
@@ -0,0 +1,49 @@
+#ifndef _MATRIX_ALLOC_H
+#define _MATRIX_ALLOC_H
+
+#include <stddef.h>
+
+/** Allocations of at least this many bytes are backed by 2 MB aligned
+ *  mmap'd memory advised for transparent huge pages; smaller ones use
+ *  malloc().  Define MATRIX_USE_HUGETLB to try explicit MAP_HUGETLB
+ *  pages (from the pre-reserved hugetlbfs pool) first.
+ */
+#ifndef MATRIX_HUGE_PAGE_THRESHOLD
+#define MATRIX_HUGE_PAGE_THRESHOLD (8L << 20)
+#endif
+
+/** Size of a huge page on x86-64 and arm64 with 4 KB base pages. */
+#define MATRIX_HUGE_PAGE_SIZE (2L << 20)
+
+/** Counters describing how matrix storage has been allocated since
+ *  program start.  Compare anonHugeKib with the dTLB miss counters
+ *  to confirm that large matrices are actually huge page backed.
+ */
+typedef struct MatrixAllocStats {
+  unsigned long nSmallAllocs;   //allocations which went to malloc()
+  unsigned long nHugeAllocs;    //allocations which went to mmap()
+  unsigned long nHugeTlbAllocs; //subset of nHugeAllocs using MAP_HUGETLB
+  unsigned long nHugeFallbacks; //large allocations which fell back to malloc()
+  unsigned long hugeBytes;      //bytes currently mapped by live huge allocations
+  long anonHugeKib;             //AnonHugePages of this process, -1 if unknown
+} MatrixAllocStats;
+
+/** Return storage for a matrix object of size bytes, or NULL with
+ *  *err set to ENOMEM.  The storage is not initialized; large
+ *  allocations should be first-touched with touchMatrixElements() so
+ *  that pages are faulted in by the threads which will use them.
+ */
+void *allocMatrixStorage(size_t size, int *err);
+
+/** Release storage returned by allocMatrixStorage(). */
+void freeMatrixStorage(void *storage);
+
+/** Set element[i] = i for i in [0, nElements), splitting the work over
+ *  parallelFor() threads when the array is large.
+ */
+void touchMatrixElements(int element[], long nElements);
+
+/** Fill *stats with the current allocation counters. */
+void getMatrixAllocStats(MatrixAllocStats *stats);
+
+#endif //ifndef _MATRIX_ALLOC_H
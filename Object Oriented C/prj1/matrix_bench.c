@@ -0,0 +1,349 @@
+/**
+ * Microbenchmark for the matrix classes.  For every registered class it
+ * times mul and transpose over a sweep of shapes (square, tall-skinny,
+ * fat, power-of-two and off-by-one sizes) and reports ns/op, GFLOP/s
+ * and bytes/flop (plus GB/s of compulsory traffic) as median and p95 over repeated runs after warmup.
+ *
+ * usage: matrix_bench [--warmup N] [--reps N] [--max-size N]
+ *                     [--class NAME] [--json FILE] [--perf]
+ *
+ * With --perf the timed runs are also counted with hardware
+ * performance counters (see perf_counters.h) and per-op cycles, IPC
+ * and cache/TLB misses are reported; counters which are unavailable
+ * on the host are reported as n/a.
+ *
+ * The JSON file holds one record per (class, op, shape) so that runs
+ * from two commits can be diffed directly.
+ */
+
+#include "dense_matrix.h"
+#include "smart_mul_matrix.h"
+#include "perf_counters.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Default number of untimed and timed runs per measurement
+ */
+#define DEFAULT_WARMUP 1
+#define DEFAULT_REPS 7
+
+/**
+ * Default largest dimension in the sweep
+ */
+#define DEFAULT_MAX_SIZE 512
+
+/** Constructor of a matrix class under test. */
+typedef Matrix *NewMatrixFn(int nRows, int nCols, int *err);
+
+/** The following struct describes a class registered with the benchmark. */
+typedef struct {
+	const char *name;			// class name
+	NewMatrixFn *newMatrix;			// constructor
+} BenchClass;
+
+/** A benchmarked shape: a[n1][n2] * b[n2][n3]; transpose uses a[n1][n2]. */
+typedef struct {
+	const char *kind;			// shape family
+	int n1, n2, n3;				// dimensions
+} BenchShape;
+
+/** Timing summary of one (class, op, shape). */
+typedef struct {
+	double medianNs;			// median time per op
+	double p95Ns;				// 95th percentile time per op
+	double flops;				// arithmetic per op, 0 for transpose
+	double bytes;				// compulsory memory traffic per op
+	PerfSample perf;			// counters summed over the timed runs
+} BenchResult;
+
+static Matrix *newDense(int nRows, int nCols, int *err)
+{
+	return (Matrix *) newDenseMatrix(nRows, nCols, err);
+}
+
+static Matrix *newSmartMul(int nRows, int nCols, int *err)
+{
+	return (Matrix *) newSmartMulMatrix(nRows, nCols, err);
+}
+
+/**
+ * Every class the benchmark knows about; add new classes here.
+ */
+static const BenchClass benchClasses[] = {
+	{ "denseMatrix", newDense },
+	{ "smartMulMatrix", newSmartMul },
+};
+
+/**
+ * The shape sweep.  Shapes with a dimension above --max-size are skipped;
+ * every family has shapes within the default limit.
+ */
+static const BenchShape benchShapes[] = {
+	{ "square", 64, 64, 64 },
+	{ "square", 128, 128, 128 },
+	{ "square", 255, 255, 255 },
+	{ "square", 256, 256, 256 },
+	{ "square", 257, 257, 257 },
+	{ "square", 511, 511, 511 },
+	{ "square", 512, 512, 512 },
+	{ "square", 513, 513, 513 },
+	{ "tall-skinny", 512, 16, 16 },
+	{ "tall-skinny", 512, 64, 32 },
+	{ "tall-skinny", 4096, 16, 16 },
+	{ "tall-skinny", 2048, 64, 32 },
+	{ "fat", 16, 512, 16 },
+	{ "fat", 32, 64, 512 },
+	{ "fat", 16, 4096, 16 },
+	{ "fat", 32, 64, 2048 },
+};
+
+#define N_CLASSES ((int) (sizeof(benchClasses) / sizeof(benchClasses[0])))
+#define N_SHAPES ((int) (sizeof(benchShapes) / sizeof(benchShapes[0])))
+
+/**
+   Run the operation once.
+*/
+static void runOp(_Bool isMul, Matrix *a, Matrix *b, Matrix *c, int *err)
+{
+	if(isMul)
+	{
+		a -> fns -> mul(a, b, c, err);
+	}
+	else
+	{
+		a -> fns -> transpose(a, c, err);
+	}
+}
+
+/**
+   Run one operation warmup + reps times and fill in the timing
+   quantiles of *result.  If counters is not NULL the timed runs are
+   also counted into result -> perf.
+*/
+static void timeOp(const char *op, Matrix *a, Matrix *b, Matrix *c,
+		   int warmup, int reps, PerfCounters *counters, BenchResult *result, int *err)
+{
+	_Bool isMul = (strcmp(op, "mul") == 0);
+	double samples[reps];
+	for(int run = 0; run < warmup + reps; run++)
+	{
+		PerfSample sample;
+		double start = perfNowNs();
+		if(counters != NULL && run >= warmup)
+		{
+			PERF_CALL(counters, &sample, runOp(isMul, a, b, c, err));
+		}
+		else
+		{
+			runOp(isMul, a, b, c, err);
+		}
+		double elapsed = perfNowNs() - start;
+		if(run >= warmup)
+		{
+			samples[run - warmup] = elapsed;
+			if(counters != NULL)
+			{
+				addPerfSample(&result -> perf, &sample);
+			}
+		}
+	}
+
+	sortPerfTimes(samples, reps);
+	result -> medianNs = perfTimeQuantile(samples, reps, 0.5);
+	result -> p95Ns = perfTimeQuantile(samples, reps, 0.95);
+}
+
+/**
+   Benchmark op on shape for class; return 0 on success or an errno.
+*/
+static int benchOne(const BenchClass *klass, const char *op, const BenchShape *shape,
+		    int warmup, int reps, PerfCounters *counters, BenchResult *result)
+{
+	int err = 0;
+	_Bool isMul = (strcmp(op, "mul") == 0);
+	Matrix *a = klass -> newMatrix(shape -> n1, shape -> n2, &err);
+	Matrix *b = isMul ? klass -> newMatrix(shape -> n2, shape -> n3, &err) : NULL;
+	Matrix *c = isMul ? klass -> newMatrix(shape -> n1, shape -> n3, &err)
+			  : klass -> newMatrix(shape -> n2, shape -> n1, &err);
+
+	if(err == 0)
+	{
+		timeOp(op, a, b, c, warmup, reps, counters, result, &err);
+	}
+
+	double elementSize = sizeof(MatrixBaseType);
+	if(isMul)
+	{
+		result -> flops = 2.0 * shape -> n1 * shape -> n2 * shape -> n3;
+		result -> bytes = elementSize * ((double) shape -> n1 * shape -> n2 +
+						 (double) shape -> n2 * shape -> n3 +
+						 (double) shape -> n1 * shape -> n3);
+	}
+	else
+	{
+		result -> flops = 0;
+		result -> bytes = elementSize * 2.0 * shape -> n1 * shape -> n2;
+	}
+
+	int freeErr = 0;
+	if(a != NULL) a -> fns -> free(a, &freeErr);
+	if(b != NULL) b -> fns -> free(b, &freeErr);
+	if(c != NULL) c -> fns -> free(c, &freeErr);
+	return err;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [--warmup N] [--reps N] [--max-size N] "
+		"[--class NAME] [--json FILE] [--perf]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char *argv[])
+{
+	int warmup = DEFAULT_WARMUP, reps = DEFAULT_REPS, maxSize = DEFAULT_MAX_SIZE;
+	const char *onlyClass = NULL, *jsonPath = NULL;
+	_Bool doPerf = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--perf") == 0)
+		{
+			doPerf = true;
+			continue;
+		}
+		if(i + 1 >= argc) usage(argv[0]);
+		if(strcmp(argv[i], "--warmup") == 0) warmup = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--reps") == 0) reps = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-size") == 0) maxSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--class") == 0) onlyClass = argv[++i];
+		else if(strcmp(argv[i], "--json") == 0) jsonPath = argv[++i];
+		else usage(argv[0]);
+	}
+	if(warmup < 0 || reps < 1 || maxSize < 1) usage(argv[0]);
+
+	PerfCounters perfCounters, *counters = NULL;
+	if(doPerf)
+	{
+		openPerfCounters(&perfCounters, 0);
+		if(hasPerfCounters(&perfCounters))
+		{
+			counters = &perfCounters;
+		}
+		else
+		{
+			fprintf(stderr, "%s: hardware performance counters unavailable\n", argv[0]);
+		}
+	}
+
+	FILE *json = NULL;
+	if(jsonPath != NULL && (json = fopen(jsonPath, "w")) == NULL)
+	{
+		fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], jsonPath, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if(json != NULL)
+	{
+		fprintf(json, "{\n  \"warmup\": %d,\n  \"reps\": %d,\n  \"results\": [", warmup, reps);
+	}
+
+	printf("%-15s %-9s %-11s %-16s %14s %14s %9s %10s %8s\n",
+	       "class", "op", "shape", "dims", "median ns/op", "p95 ns/op", "GFLOP/s", "bytes/flop", "GB/s");
+
+	const char *ops[] = { "mul", "transpose" };
+	int nRecords = 0;
+	for(int k = 0; k < N_CLASSES; k++)
+	{
+		const BenchClass *klass = &benchClasses[k];
+		if(onlyClass != NULL && strcmp(onlyClass, klass -> name) != 0) continue;
+
+		for(int o = 0; o < 2; o++)
+		{
+			for(int s = 0; s < N_SHAPES; s++)
+			{
+				const BenchShape *shape = &benchShapes[s];
+				_Bool isMul = (o == 0);
+				if(shape -> n1 > maxSize || shape -> n2 > maxSize ||
+				   (isMul && shape -> n3 > maxSize))
+				{
+					continue;
+				}
+				BenchResult result = { 0 };
+				int err = benchOne(klass, ops[o], shape, warmup, reps, counters, &result);
+				if(err != 0)
+				{
+					fprintf(stderr, "%s %s %dx%dx%d: %s\n", klass -> name, ops[o],
+						shape -> n1, shape -> n2, shape -> n3, strerror(err));
+					continue;
+				}
+
+				char dims[32];
+				if(isMul) snprintf(dims, sizeof(dims), "%dx%dx%d", shape -> n1, shape -> n2, shape -> n3);
+				else snprintf(dims, sizeof(dims), "%dx%d", shape -> n1, shape -> n2);
+
+				double gflops = result.flops / result.medianNs;
+				double bytesPerFlop = (result.flops > 0) ? result.bytes / result.flops : 0;
+				double gbytes = result.bytes / result.medianNs;
+				if(isMul)
+				{
+					printf("%-15s %-9s %-11s %-16s %14.0f %14.0f %9.3f %10.4f %8.3f\n",
+					       klass -> name, ops[o], shape -> kind, dims,
+					       result.medianNs, result.p95Ns, gflops, bytesPerFlop, gbytes);
+				}
+				else
+				{
+					printf("%-15s %-9s %-11s %-16s %14.0f %14.0f %9s %10s %8.3f\n",
+					       klass -> name, ops[o], shape -> kind, dims,
+					       result.medianNs, result.p95Ns, "-", "-", gbytes);
+				}
+				char perfText[256] = "";
+				if(counters != NULL)
+				{
+					formatPerfSample(&result.perf, reps, perfText, sizeof(perfText));
+					printf("    perf/op: %s\n", perfText);
+				}
+				fflush(stdout);
+
+				if(json != NULL)
+				{
+					fprintf(json, "%s\n    {\"class\": \"%s\", \"op\": \"%s\", \"shape\": \"%s\", "
+						"\"n1\": %d, \"n2\": %d, \"n3\": %d, "
+						"\"median_ns\": %.0f, \"p95_ns\": %.0f, \"gflops\": %.6f, "
+						"\"bytes_per_flop\": %.6f, \"bytes\": %.0f, \"gbytes_per_s\": %.6f",
+						(nRecords++ > 0) ? "," : "",
+						klass -> name, ops[o], shape -> kind,
+						shape -> n1, shape -> n2, isMul ? shape -> n3 : 0,
+						result.medianNs, result.p95Ns, gflops, bytesPerFlop, result.bytes, gbytes);
+					for(int event = 0; counters != NULL && event < N_PERF_EVENTS; event++)
+					{
+						if(result.perf.valid[event])
+						{
+							fprintf(json, ", \"%s_per_op\": %.0f", perfEventName(event),
+								(double) result.perf.values[event] / reps);
+						}
+						else
+						{
+							fprintf(json, ", \"%s_per_op\": null", perfEventName(event));
+						}
+					}
+					fprintf(json, "}");
+				}
+			}
+		}
+	}
+
+	if(json != NULL)
+	{
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	if(counters != NULL)
+	{
+		closePerfCounters(counters);
+	}
+	return 0;
+}
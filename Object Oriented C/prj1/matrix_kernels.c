@@ -0,0 +1,243 @@
+#include "matrix_kernels.h"
+
+#include <stdlib.h>
+
+/**
+ * Number of ints processed by one vector operation
+ */
+#define VECTOR_INTS 8
+
+/** Vector of ints.  aligned(4) allows loads and stores at any int
+    address, may_alias allows it to access plain int arrays.
+*/
+typedef int IntVector __attribute__((vector_size(VECTOR_INTS * sizeof(int)), aligned(4), may_alias));
+
+/**
+   Return the smaller of two ints.
+*/
+static inline int minInt(int a, int b)
+{
+	return (a < b) ? a : b;
+}
+
+/**
+   Blocked transpose.  A naive transpose writes dst with a stride of
+   nRows elements, touching a new cache line (and for large matrices a
+   new page) on every store; walking tile x tile blocks keeps both the
+   source rows and destination rows of a block in cache.
+*/
+void transposeKernel(const int *src, int nRows, int nCols, int *dst, int tile)
+{
+	for(int rowTile = 0; rowTile < nRows; rowTile += tile)
+	{
+		int rowEnd = minInt(rowTile + tile, nRows);
+		for(int colTile = 0; colTile < nCols; colTile += tile)
+		{
+			int colEnd = minInt(colTile + tile, nCols);
+			for(int row = rowTile; row < rowEnd; row++)
+			{
+				for(int col = colTile; col < colEnd; col++)
+				{
+					dst[(long) col * nRows + row] = src[(long) row * nCols + col];
+				}
+			}
+		}
+	}
+}
+
+/**
+   Blocked multiply against a transposed multiplier.  For every tile of
+   c the shared dimension is walked in tile-wide panels, so the panel of
+   a (tile rows) and the panel of bT (tile rows) are reused tile times
+   each before being evicted.
+*/
+void mulTransposedKernel(const int *a, const int *bT, int n1, int n2, int n3,
+                         int *c, int rowLo, int rowHi, int tile)
+{
+	(void) n1;
+
+	for(long i = (long) rowLo * n3; i < (long) rowHi * n3; i++)
+	{
+		c[i] = 0;						// products are accumulated
+	}
+
+	for(int rowTile = rowLo; rowTile < rowHi; rowTile += tile)
+	{
+		int rowEnd = minInt(rowTile + tile, rowHi);
+		for(int colTile = 0; colTile < n3; colTile += tile)
+		{
+			int colEnd = minInt(colTile + tile, n3);
+			for(int kTile = 0; kTile < n2; kTile += tile)
+			{
+				int kEnd = minInt(kTile + tile, n2);
+				for(int row = rowTile; row < rowEnd; row++)
+				{
+					const int *aRow = a + (long) row * n2;
+					int *cRow = c + (long) row * n3;
+					for(int col = colTile; col < colEnd; col++)
+					{
+						const int *bTRow = bT + (long) col * n2;
+						int sum = 0;
+						for(int k = kTile; k < kEnd; k++)
+						{
+							sum += aRow[k] * bTRow[k];
+						}
+						cRow[col] += sum;
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+   Element-wise sum: whole vectors first, then the remaining entries.
+*/
+void addKernel(const int *a, const int *b, int *c, long lo, long hi)
+{
+	long i = lo;
+	for(; i + VECTOR_INTS <= hi; i += VECTOR_INTS)
+	{
+		*(IntVector *) (c + i) = *(const IntVector *) (a + i) + *(const IntVector *) (b + i);
+	}
+	for(; i < hi; i++)
+	{
+		c[i] = a[i] + b[i];
+	}
+}
+
+/**
+   Element-wise scaling by a broadcast factor.
+*/
+void scaleKernel(const int *a, int factor, int *c, long lo, long hi)
+{
+	IntVector factors = { 0 };
+	factors += factor;					// broadcast to every lane
+
+	long i = lo;
+	for(; i + VECTOR_INTS <= hi; i += VECTOR_INTS)
+	{
+		*(IntVector *) (c + i) = *(const IntVector *) (a + i) * factors;
+	}
+	for(; i < hi; i++)
+	{
+		c[i] = a[i] * factor;
+	}
+}
+
+/**
+   Element-wise product.
+*/
+void hadamardKernel(const int *a, const int *b, int *c, long lo, long hi)
+{
+	long i = lo;
+	for(; i + VECTOR_INTS <= hi; i += VECTOR_INTS)
+	{
+		*(IntVector *) (c + i) = *(const IntVector *) (a + i) * *(const IntVector *) (b + i);
+	}
+	for(; i < hi; i++)
+	{
+		c[i] = a[i] * b[i];
+	}
+}
+
+/**
+   Row sums: each row is reduced into a vector of partial sums which is
+   folded into a scalar once per row.
+*/
+void rowSumsKernel(const int *a, int nCols, int *sums, int rowLo, int rowHi)
+{
+	for(int row = rowLo; row < rowHi; row++)
+	{
+		const int *aRow = a + (long) row * nCols;
+		IntVector partial = { 0 };
+		int col = 0;
+		for(; col + VECTOR_INTS <= nCols; col += VECTOR_INTS)
+		{
+			partial += *(const IntVector *) (aRow + col);
+		}
+
+		int sum = 0;
+		for(int lane = 0; lane < VECTOR_INTS; lane++)
+		{
+			sum += partial[lane];
+		}
+		for(; col < nCols; col++)
+		{
+			sum += aRow[col];
+		}
+		sums[row] = sum;
+	}
+}
+
+/**
+   Column sums: rows are added into sums[] a vector at a time, so the
+   matrix is still read with unit stride.
+*/
+void colSumsKernel(const int *a, int nCols, int *sums, int rowLo, int rowHi)
+{
+	for(int row = rowLo; row < rowHi; row++)
+	{
+		addKernel(sums, a + (long) row * nCols, sums, 0, nCols);
+	}
+}
+
+/**
+   Row sums of absolute values in 64 bits.
+*/
+void absRowSumsKernel(const int *a, int nCols, long long *sums, int rowLo, int rowHi)
+{
+	for(int row = rowLo; row < rowHi; row++)
+	{
+		const int *aRow = a + (long) row * nCols;
+		long long sum = 0;
+		for(int col = 0; col < nCols; col++)
+		{
+			sum += llabs(aRow[col]);
+		}
+		sums[row] = sum;
+	}
+}
+
+/**
+   Column sums of absolute values in 64 bits.
+*/
+void absColSumsKernel(const int *a, int nCols, long long *sums, int rowLo, int rowHi)
+{
+	for(int row = rowLo; row < rowHi; row++)
+	{
+		const int *aRow = a + (long) row * nCols;
+		for(int col = 0; col < nCols; col++)
+		{
+			sums[col] += llabs(aRow[col]);
+		}
+	}
+}
+
+/**
+   Sum of squares in 64 bits; integer reductions are associative so the
+   compiler is free to vectorize this loop.
+*/
+long long sumSquaresKernel(const int *a, long lo, long hi)
+{
+	long long sum = 0;
+	for(long i = lo; i < hi; i++)
+	{
+		sum += (long long) a[i] * a[i];
+	}
+	return sum;
+}
+
+/**
+   Maximum absolute value in 64 bits so that |INT_MIN| is representable.
+*/
+long long maxAbsKernel(const int *a, long lo, long hi)
+{
+	long long max = 0;
+	for(long i = lo; i < hi; i++)
+	{
+		long long value = llabs(a[i]);
+		max = (value > max) ? value : max;
+	}
+	return max;
+}
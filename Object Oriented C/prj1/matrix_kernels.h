@@ -0,0 +1,51 @@
+#ifndef _MATRIX_KERNELS_H
+#define _MATRIX_KERNELS_H
+
+/** Kernels which work directly on row-major element arrays.  Matrix
+ *  classes with contiguous storage call these when all operands are
+ *  of their own class, instead of going through getElement() and
+ *  setElement() for every entry.
+ */
+
+/** Set dst[nCols][nRows] to the transpose of src[nRows][nCols], working
+ *  on tile x tile blocks so that both the reads and the writes stay
+ *  within a few cache lines.
+ */
+void transposeKernel(const int *src, int nRows, int nCols, int *dst, int tile);
+
+/** Set rows [rowLo, rowHi) of c[n1][n3] to a[n1][n2] * b[n2][n3] where
+ *  bT[n3][n2] is the transpose of the multiplier.  The product is
+ *  blocked into tile x tile tiles of c with tile-wide panels of the
+ *  shared dimension, so each dot product runs over two unit stride
+ *  rows which stay cache resident while the tile is computed.
+ */
+void mulTransposedKernel(const int *a, const int *bT, int n1, int n2, int n3,
+                         int *c, int rowLo, int rowHi, int tile);
+
+/** Element-wise kernels over entries [lo, hi) of arrays of the same
+ *  shape.  They are written with GCC vector types so they run with
+ *  SIMD instructions at any optimization level.
+ */
+void addKernel(const int *a, const int *b, int *c, long lo, long hi);
+void scaleKernel(const int *a, int factor, int *c, long lo, long hi);
+void hadamardKernel(const int *a, const int *b, int *c, long lo, long hi);
+
+/** Set sums[row] to the sum of each row in [rowLo, rowHi) of a[][nCols]. */
+void rowSumsKernel(const int *a, int nCols, int *sums, int rowLo, int rowHi);
+
+/** Add rows [rowLo, rowHi) of a[][nCols] into sums[nCols]. */
+void colSumsKernel(const int *a, int nCols, int *sums, int rowLo, int rowHi);
+
+/** As rowSumsKernel() and colSumsKernel() but summing absolute values
+ *  into 64-bit sums, as needed for the one and infinity norms.
+ */
+void absRowSumsKernel(const int *a, int nCols, long long *sums, int rowLo, int rowHi);
+void absColSumsKernel(const int *a, int nCols, long long *sums, int rowLo, int rowHi);
+
+/** Return the sum of squares, and the maximum absolute value, of
+ *  entries [lo, hi) of a.
+ */
+long long sumSquaresKernel(const int *a, long lo, long hi);
+long long maxAbsKernel(const int *a, long lo, long hi);
+
+#endif //ifndef _MATRIX_KERNELS_H
@@ -0,0 +1,570 @@
+#include "matrix_ops.h"
+#include "matrix_kernels.h"
+#include "matrix_parallel.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * Maximum number of classes which can register operations
+ */
+#define MAX_OPS_CLASSES 16
+
+/**
+ * Minimum number of entries handled by each thread; below this the
+ * operations are memory bound on a single core anyway.
+ */
+#define PARALLEL_CHUNK (1L << 16)
+
+/** The following struct associates the virtual table of a class with
+    the operations registered for it.
+*/
+typedef struct {
+	const MatrixFns *fns;			// class virtual table
+	const MatrixOpsFns *ops;		// operations for the class
+} OpsRegistration;
+
+static OpsRegistration registrations[MAX_OPS_CLASSES];	// registered classes
+static int nRegistrations = 0;				// number of registered classes
+
+/** Arguments shared by the threads of a direct (array based) operation.
+    Reductions which need per-thread partial results split the work into
+    nBlocks blocks, each with its own slice of partials.
+*/
+typedef struct {
+	const int *a;				// first operand
+	const int *b;				// second operand, if any
+	int *c;					// result
+	int factor;				// scale factor
+	int nRows;				// rows of the operands
+	int nCols;				// cols of the operands
+	int nBlocks;				// number of reduction blocks
+	int *sums;				// int row/col sums
+	long long *partials;			// 64-bit reduction partials
+} OpArgs;
+
+/**
+   Register the operations for a class, replacing any earlier registration.
+*/
+void registerMatrixOpsFns(const MatrixFns *fns, const MatrixOpsFns *ops)
+{
+	for(int i = 0; i < nRegistrations; i++)
+	{
+		if(registrations[i].fns == fns)
+		{
+			registrations[i].ops = ops;		// replace
+			return;
+		}
+	}
+	if(nRegistrations < MAX_OPS_CLASSES)
+	{
+		registrations[nRegistrations].fns = fns;
+		registrations[nRegistrations].ops = ops;
+		nRegistrations++;
+	}
+}
+
+/**
+   Look up the operations of the class of m.
+*/
+const MatrixOpsFns *getMatrixOpsFns(const Matrix *m)
+{
+	for(int i = 0; i < nRegistrations; i++)
+	{
+		if(registrations[i].fns == m -> fns)
+		{
+			return registrations[i].ops;
+		}
+	}
+	return getAbstractMatrixOpsFns();
+}
+
+/**
+   Return the contiguous entries of m, or NULL.
+*/
+static int *elementsOf(const Matrix *m)
+{
+	const MatrixOpsFns *ops = getMatrixOpsFns(m);
+	return (ops -> elements != NULL) ? ops -> elements(m) : NULL;
+}
+
+/**
+   Get the dimensions of this and check them; return false with *err set
+   for an invalid matrix.
+*/
+static _Bool getShape(const Matrix *this, int *nRows, int *nCols, int *err)
+{
+	*nRows = this -> fns -> getNRows(this, err);		// get rows in matrix
+	*nCols = this -> fns -> getNCols(this, err);		// get cols in matrix
+	if(*nRows <= 0 || *nCols <= 0)				// matrix validity check
+	{
+		*err = EINVAL;					// set error code
+		return false;
+	}
+	return true;
+}
+
+/**
+   Check that other has the dimensions nRows x nCols.
+*/
+static _Bool checkShape(const Matrix *other, int nRows, int nCols, int *err)
+{
+	int otherRows, otherCols;
+	if(!getShape(other, &otherRows, &otherCols, err))
+	{
+		return false;
+	}
+	if(otherRows != nRows || otherCols != nCols)		// not compatible dimensions
+	{
+		*err = EDOM;					// set error code
+		return false;
+	}
+	return true;
+}
+
+/**
+   Return the number of reduction blocks for n entries.
+*/
+static int blockCount(long n)
+{
+	long nBlocks = n / PARALLEL_CHUNK;
+	if(nBlocks > getParallelThreads())
+	{
+		nBlocks = getParallelThreads();
+	}
+	return (nBlocks < 1) ? 1 : (int) nBlocks;
+}
+
+/**
+   Loop bodies for parallelFor(): element-wise operations over entries.
+*/
+static void addRange(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	addKernel(args -> a, args -> b, args -> c, lo, hi);
+}
+
+static void scaleRange(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	scaleKernel(args -> a, args -> factor, args -> c, lo, hi);
+}
+
+static void hadamardRange(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	hadamardKernel(args -> a, args -> b, args -> c, lo, hi);
+}
+
+/**
+   Loop bodies for parallelFor(): row reductions over rows.
+*/
+static void rowSumsRange(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	rowSumsKernel(args -> a, args -> nCols, args -> sums, (int) lo, (int) hi);
+}
+
+static void absRowSumsRange(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	absRowSumsKernel(args -> a, args -> nCols, args -> partials, (int) lo, (int) hi);
+}
+
+/**
+   Loop bodies for parallelFor(): reductions over blocks, each block
+   writing its own partial results.
+*/
+static void colSumsBlocks(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	for(long block = lo; block < hi; block++)
+	{
+		int *partial = args -> sums + block * args -> nCols;
+		for(int col = 0; col < args -> nCols; col++)
+		{
+			partial[col] = 0;
+		}
+		colSumsKernel(args -> a, args -> nCols, partial,
+			      (int) (args -> nRows * block / args -> nBlocks),
+			      (int) (args -> nRows * (block + 1) / args -> nBlocks));
+	}
+}
+
+static void absColSumsBlocks(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	for(long block = lo; block < hi; block++)
+	{
+		long long *partial = args -> partials + block * args -> nCols;
+		for(int col = 0; col < args -> nCols; col++)
+		{
+			partial[col] = 0;
+		}
+		absColSumsKernel(args -> a, args -> nCols, partial,
+				 (int) (args -> nRows * block / args -> nBlocks),
+				 (int) (args -> nRows * (block + 1) / args -> nBlocks));
+	}
+}
+
+static void sumSquaresBlocks(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	long n = (long) args -> nRows * args -> nCols;
+	for(long block = lo; block < hi; block++)
+	{
+		args -> partials[block] = sumSquaresKernel(args -> a, n * block / args -> nBlocks,
+							   n * (block + 1) / args -> nBlocks);
+	}
+}
+
+static void maxAbsBlocks(long lo, long hi, void *p)
+{
+	OpArgs *args = p;
+	long n = (long) args -> nRows * args -> nCols;
+	for(long block = lo; block < hi; block++)
+	{
+		args -> partials[block] = maxAbsKernel(args -> a, n * block / args -> nBlocks,
+						       n * (block + 1) / args -> nBlocks);
+	}
+}
+
+/** Element-wise binary operation shared by add and hadamard: direct
+    and parallel when all three matrices have contiguous entries,
+    otherwise through getElement()/setElement().
+*/
+static void elementwise(const Matrix *this, const Matrix *other, Matrix *result,
+			ParallelBody *direct, _Bool isProduct, int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err) || !checkShape(other, nRows, nCols, err) ||
+	   !checkShape(result, nRows, nCols, err))
+	{
+		return;
+	}
+
+	OpArgs args = { .a = elementsOf(this), .b = elementsOf(other), .c = elementsOf(result) };
+	if(args.a != NULL && args.b != NULL && args.c != NULL)
+	{
+		parallelFor((long) nRows * nCols, PARALLEL_CHUNK, direct, &args);
+		return;
+	}
+
+	for(int row = 0; row < nRows; row++)
+	{
+		for(int col = 0; col < nCols; col++)
+		{
+			MatrixBaseType first = this -> fns -> getElement(this, row, col, err);
+			MatrixBaseType second = other -> fns -> getElement(other, row, col, err);
+			result -> fns -> setElement(result, row, col, isProduct ? first * second : first + second, err);
+		}
+	}
+}
+
+/**
+   Matrix sum.
+*/
+static void add(const Matrix *this, const Matrix *addend, Matrix *sum, int *err)
+{
+	elementwise(this, addend, sum, addRange, false, err);
+}
+
+/**
+   Element-wise (Hadamard) product.
+*/
+static void hadamard(const Matrix *this, const Matrix *multiplier, Matrix *product, int *err)
+{
+	elementwise(this, multiplier, product, hadamardRange, true, err);
+}
+
+/**
+   Scalar multiple.
+*/
+static void scale(const Matrix *this, MatrixBaseType factor, Matrix *result, int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err) || !checkShape(result, nRows, nCols, err))
+	{
+		return;
+	}
+
+	OpArgs args = { .a = elementsOf(this), .c = elementsOf(result), .factor = factor };
+	if(args.a != NULL && args.c != NULL)
+	{
+		parallelFor((long) nRows * nCols, PARALLEL_CHUNK, scaleRange, &args);
+		return;
+	}
+
+	for(int row = 0; row < nRows; row++)
+	{
+		for(int col = 0; col < nCols; col++)
+		{
+			MatrixBaseType element = this -> fns -> getElement(this, row, col, err);
+			result -> fns -> setElement(result, row, col, factor * element, err);
+		}
+	}
+}
+
+/**
+   Sums of each row.
+*/
+static void rowSums(const Matrix *this, MatrixBaseType sums[], int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err))
+	{
+		return;
+	}
+
+	OpArgs args = { .a = elementsOf(this), .nCols = nCols, .sums = sums };
+	if(args.a != NULL)
+	{
+		parallelFor(nRows, PARALLEL_CHUNK / nCols + 1, rowSumsRange, &args);
+		return;
+	}
+
+	for(int row = 0; row < nRows; row++)
+	{
+		sums[row] = 0;
+		for(int col = 0; col < nCols; col++)
+		{
+			sums[row] += this -> fns -> getElement(this, row, col, err);
+		}
+	}
+}
+
+/**
+   Sums of each column.  Direct sums are accumulated per block of rows
+   and the block partials are added at the end.
+*/
+static void colSums(const Matrix *this, MatrixBaseType sums[], int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err))
+	{
+		return;
+	}
+
+	OpArgs args = { .a = elementsOf(this), .nRows = nRows, .nCols = nCols };
+	if(args.a != NULL)
+	{
+		args.nBlocks = blockCount((long) nRows * nCols);
+		args.sums = malloc((size_t) args.nBlocks * nCols * sizeof(int));
+		if(args.sums == NULL)
+		{
+			*err = ENOMEM;				// set error code
+			return;
+		}
+		parallelFor(args.nBlocks, 1, colSumsBlocks, &args);
+
+		for(int col = 0; col < nCols; col++)
+		{
+			sums[col] = 0;
+		}
+		for(int block = 0; block < args.nBlocks; block++)
+		{
+			addKernel(sums, args.sums + (long) block * nCols, sums, 0, nCols);
+		}
+		free(args.sums);
+		return;
+	}
+
+	for(int col = 0; col < nCols; col++)
+	{
+		sums[col] = 0;
+	}
+	for(int row = 0; row < nRows; row++)
+	{
+		for(int col = 0; col < nCols; col++)
+		{
+			sums[col] += this -> fns -> getElement(this, row, col, err);
+		}
+	}
+}
+
+/**
+   Direct norm of contiguous entries a[nRows][nCols].  Return -1 with
+   *err set if scratch space cannot be allocated.
+*/
+static double directNorm(const int *a, int nRows, int nCols, MatrixNormKind kind, int *err)
+{
+	OpArgs args = { .a = a, .nRows = nRows, .nCols = nCols };
+	args.nBlocks = blockCount((long) nRows * nCols);
+
+	long nPartials = args.nBlocks;				// one per block
+	if(kind == MATRIX_NORM_INF)
+	{
+		nPartials = nRows;				// one per row
+	}
+	else if(kind == MATRIX_NORM_ONE)
+	{
+		nPartials = (long) args.nBlocks * nCols;	// one per block and col
+	}
+
+	args.partials = malloc(nPartials * sizeof(long long));
+	if(args.partials == NULL)
+	{
+		*err = ENOMEM;					// set error code
+		return -1;
+	}
+
+	long long result = 0;
+	switch(kind)
+	{
+		case MATRIX_NORM_FROBENIUS:
+			parallelFor(args.nBlocks, 1, sumSquaresBlocks, &args);
+			for(int block = 0; block < args.nBlocks; block++)
+			{
+				result += args.partials[block];
+			}
+			free(args.partials);
+			return sqrt((double) result);
+
+		case MATRIX_NORM_MAX:
+			parallelFor(args.nBlocks, 1, maxAbsBlocks, &args);
+			for(int block = 0; block < args.nBlocks; block++)
+			{
+				result = (args.partials[block] > result) ? args.partials[block] : result;
+			}
+			break;
+
+		case MATRIX_NORM_INF:
+			parallelFor(nRows, PARALLEL_CHUNK / nCols + 1, absRowSumsRange, &args);
+			for(int row = 0; row < nRows; row++)
+			{
+				result = (args.partials[row] > result) ? args.partials[row] : result;
+			}
+			break;
+
+		case MATRIX_NORM_ONE:
+			parallelFor(args.nBlocks, 1, absColSumsBlocks, &args);
+			for(int col = 0; col < nCols; col++)
+			{
+				long long sum = 0;
+				for(int block = 0; block < args.nBlocks; block++)
+				{
+					sum += args.partials[(long) block * nCols + col];
+				}
+				result = (sum > result) ? sum : result;
+			}
+			break;
+	}
+
+	free(args.partials);
+	return (double) result;
+}
+
+/**
+   Norm of the requested kind.
+*/
+static double norm(const Matrix *this, MatrixNormKind kind, int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err))
+	{
+		return -1;
+	}
+	if(kind != MATRIX_NORM_ONE && kind != MATRIX_NORM_INF &&
+	   kind != MATRIX_NORM_FROBENIUS && kind != MATRIX_NORM_MAX)
+	{
+		*err = EINVAL;					// unknown norm
+		return -1;
+	}
+
+	const int *a = elementsOf(this);
+	if(a != NULL)
+	{
+		return directNorm(a, nRows, nCols, kind, err);
+	}
+
+	/**
+	  Generic norm: row sums, column sums and the element-wise
+	  reductions are all accumulated in a single pass.
+	*/
+	long long *colAbsSums = calloc(nCols, sizeof(long long));
+	if(colAbsSums == NULL)
+	{
+		*err = ENOMEM;					// set error code
+		return -1;
+	}
+
+	long long maxRowSum = 0, maxAbs = 0, sumSquares = 0;
+	for(int row = 0; row < nRows; row++)
+	{
+		long long rowSum = 0;
+		for(int col = 0; col < nCols; col++)
+		{
+			long long element = this -> fns -> getElement(this, row, col, err);
+			long long absElement = llabs(element);
+			rowSum += absElement;
+			colAbsSums[col] += absElement;
+			sumSquares += element * element;
+			maxAbs = (absElement > maxAbs) ? absElement : maxAbs;
+		}
+		maxRowSum = (rowSum > maxRowSum) ? rowSum : maxRowSum;
+	}
+
+	long long maxColSum = 0;
+	for(int col = 0; col < nCols; col++)
+	{
+		maxColSum = (colAbsSums[col] > maxColSum) ? colAbsSums[col] : maxColSum;
+	}
+	free(colAbsSums);
+
+	switch(kind)
+	{
+		case MATRIX_NORM_ONE: return (double) maxColSum;
+		case MATRIX_NORM_INF: return (double) maxRowSum;
+		case MATRIX_NORM_FROBENIUS: return sqrt((double) sumSquares);
+		default: return (double) maxAbs;
+	}
+}
+
+/**
+   Sum of the diagonal of a square matrix.
+*/
+static MatrixBaseType trace(const Matrix *this, int *err)
+{
+	int nRows, nCols;
+	if(!getShape(this, &nRows, &nCols, err))
+	{
+		return -1;
+	}
+	if(nRows != nCols)					// only square matrices have a trace
+	{
+		*err = EDOM;					// set error code
+		return -1;
+	}
+
+	MatrixBaseType sum = 0;
+	const int *a = elementsOf(this);
+	for(int i = 0; i < nRows; i++)
+	{
+		sum += (a != NULL) ? a[(long) i * nCols + i] : this -> fns -> getElement(this, i, i, err);
+	}
+	return sum;
+}
+
+/** Initializing Function Pointers of the abstract operations.  The
+    abstract class has no contiguous storage so elements is NULL.
+*/
+static MatrixOpsFns matrixOpsFns = {
+
+	.elements = NULL,		// no contiguous storage
+	.add = add,			// implemented above
+	.scale = scale,			// implemented above
+	.hadamard = hadamard,		// implemented above
+	.rowSums = rowSums,		// implemented above
+	.colSums = colSums,		// implemented above
+	.norm = norm,			// implemented above
+	.trace = trace			// implemented above
+};
+
+/** Return the abstract implementation of the operations. */
+const MatrixOpsFns *
+getAbstractMatrixOpsFns(void)
+{
+	return &matrixOpsFns;		// return address of operations table to derive by the sub-classes
+}
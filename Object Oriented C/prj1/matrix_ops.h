@@ -0,0 +1,79 @@
+#ifndef _MATRIX_OPS_H
+#define _MATRIX_OPS_H
+
+#include "matrix.h"
+
+/** Norms computed by MatrixOpsFns.norm(). */
+typedef enum {
+  MATRIX_NORM_ONE,              //max over columns of sum of |entries|
+  MATRIX_NORM_INF,              //max over rows of sum of |entries|
+  MATRIX_NORM_FROBENIUS,        //square root of sum of squared entries
+  MATRIX_NORM_MAX               //max |entry|
+} MatrixNormKind;
+
+/** Element-wise and reduction operations on matrices.  This is a second
+ *  virtual table alongside MatrixFns: each class registers its table
+ *  with registerMatrixOpsFns() and callers look it up with
+ *  getMatrixOpsFns().  The abstract implementations only use
+ *  MatrixFns; a class which stores its entries in a contiguous
+ *  row-major array provides elements() so that these operations run
+ *  vectorized (and multi-threaded for large matrices, see
+ *  matrix_parallel.h) directly on the array.
+ *
+ *  All operations set *err to EINVAL for invalid matrices and to EDOM
+ *  for incompatible dimensions.
+ */
+typedef struct MatrixOpsFns {
+
+  /** Return the row-major array holding the entries of this, or NULL
+   *  if the entries are not stored contiguously.
+   */
+  MatrixBaseType *(*elements)(const Matrix *this);
+
+  /** Set sum = this + addend. */
+  void (*add)(const Matrix *this, const Matrix *addend, Matrix *sum, int *err);
+
+  /** Set result = factor * this. */
+  void (*scale)(const Matrix *this, MatrixBaseType factor, Matrix *result,
+                int *err);
+
+  /** Set product to the element-wise (Hadamard) product of this and
+   *  multiplier.
+   */
+  void (*hadamard)(const Matrix *this, const Matrix *multiplier,
+                   Matrix *product, int *err);
+
+  /** Set sums[i] to the sum of row i of this; sums must have nRows
+   *  entries.
+   */
+  void (*rowSums)(const Matrix *this, MatrixBaseType sums[], int *err);
+
+  /** Set sums[j] to the sum of column j of this; sums must have nCols
+   *  entries.
+   */
+  void (*colSums)(const Matrix *this, MatrixBaseType sums[], int *err);
+
+  /** Return the norm of this of the specified kind. */
+  double (*norm)(const Matrix *this, MatrixNormKind kind, int *err);
+
+  /** Return the sum of the diagonal of square matrix this. */
+  MatrixBaseType (*trace)(const Matrix *this, int *err);
+
+} MatrixOpsFns;
+
+/** Register ops as the operations for all matrices whose virtual table
+ *  is fns.  Registering the same fns again replaces its operations.
+ */
+void registerMatrixOpsFns(const MatrixFns *fns, const MatrixOpsFns *ops);
+
+/** Return the operations registered for the class of matrix m, or the
+ *  abstract operations if none were registered.
+ */
+const MatrixOpsFns *getMatrixOpsFns(const Matrix *m);
+
+/** Return the abstract implementation of the operations; sub-classes
+ *  copy this table and override entries such as elements().
+ */
+const MatrixOpsFns *getAbstractMatrixOpsFns(void);
+
+#endif //ifndef _MATRIX_OPS_H
@@ -0,0 +1,108 @@
+#include "matrix_parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Upper bound on the number of threads used by a single parallel loop
+ */
+#define MAX_PARALLEL_THREADS 64
+
+/** The following struct represents the work handed to a single thread
+    of a parallel loop: the range of iterations and the loop body.
+*/
+typedef struct {
+	ParallelBody *body;			// loop body
+	void *arg;				// caller argument
+	long lo;				// first iteration
+	long hi;				// one past last iteration
+} ParallelRange;
+
+static int nThreads = 0;			// cached thread count, 0 until computed
+
+/**
+   Return the number of threads used by parallelFor().
+*/
+int getParallelThreads(void)
+{
+	if(nThreads == 0)
+	{
+		const char *env = getenv("MATRIX_THREADS");		// user override
+		long n = (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+		if(n <= 0)
+		{
+			n = 1;						// unknown: run serially
+		}
+		else if(n > MAX_PARALLEL_THREADS)
+		{
+			n = MAX_PARALLEL_THREADS;
+		}
+		nThreads = (int) n;
+	}
+	return nThreads;
+}
+
+/**
+   Thread entry point: run the body over a single range.
+*/
+static void *runRange(void *p)
+{
+	ParallelRange *range = p;
+	range -> body(range -> lo, range -> hi, range -> arg);
+	return NULL;
+}
+
+/**
+   Split [0, n) into one contiguous range per thread; the calling thread
+   runs the first range itself so a loop never waits on an idle thread.
+*/
+void parallelFor(long n, long minChunk, ParallelBody *body, void *arg)
+{
+	if(minChunk < 1)
+	{
+		minChunk = 1;
+	}
+
+	long nRanges = n / minChunk;
+	if(nRanges > getParallelThreads())
+	{
+		nRanges = getParallelThreads();
+	}
+	if(nRanges <= 1)
+	{
+		body(0, n, arg);					// not worth splitting
+		return;
+	}
+
+	ParallelRange ranges[MAX_PARALLEL_THREADS];
+	pthread_t threads[MAX_PARALLEL_THREADS];
+	_Bool started[MAX_PARALLEL_THREADS];
+
+	for(long i = 0; i < nRanges; i++)
+	{
+		ranges[i].body = body;
+		ranges[i].arg = arg;
+		ranges[i].lo = n * i / nRanges;
+		ranges[i].hi = n * (i + 1) / nRanges;
+	}
+
+	for(long i = 1; i < nRanges; i++)
+	{
+		started[i] = (pthread_create(&threads[i], NULL, runRange, &ranges[i]) == 0);
+	}
+
+	runRange(&ranges[0]);
+
+	for(long i = 1; i < nRanges; i++)
+	{
+		if(started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+		else
+		{
+			runRange(&ranges[i]);				// thread creation failed
+		}
+	}
+}
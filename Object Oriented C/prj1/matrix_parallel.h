@@ -0,0 +1,23 @@
+#ifndef _MATRIX_PARALLEL_H
+#define _MATRIX_PARALLEL_H
+
+/** Body of a parallel loop: process iterations [lo, hi) using the
+ *  caller supplied arg.
+ */
+typedef void ParallelBody(long lo, long hi, void *arg);
+
+/** Return the number of threads used by parallelFor(); this is the
+ *  number of online CPUs unless overridden by the MATRIX_THREADS
+ *  environment variable.
+ */
+int getParallelThreads(void);
+
+/** Run body over iterations [0, n) split into contiguous ranges of at
+ *  least minChunk iterations, one range per thread.  Ranges are run
+ *  in the calling thread when n is too small to be worth splitting or
+ *  when threads cannot be created.  Returns only after all iterations
+ *  have been run.
+ */
+void parallelFor(long n, long minChunk, ParallelBody *body, void *arg);
+
+#endif //ifndef _MATRIX_PARALLEL_H
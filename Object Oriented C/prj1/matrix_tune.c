@@ -0,0 +1,324 @@
+#include "matrix_tune.h"
+#include "matrix_kernels.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Sysfs directory describing the caches of the first CPU
+ */
+#define CACHE_SYSFS_DIR "/sys/devices/system/cpu/cpu0/cache"
+
+/**
+ * Bounds on tile sizes
+ */
+#define MIN_TILE 8
+#define MAX_TILE 256
+
+/**
+ * Sizes of the problems timed by tuneMatrixKernels()
+ */
+#define TUNE_MUL_N 384
+#define TUNE_TRANSPOSE_N 2048
+#define TUNE_REPEATS 3
+
+static MatrixTuning tuning;			// tuning in effect for this process
+static _Bool isLoaded = false;			// load tuning only once
+
+/**
+   Parse a sysfs cache size such as "32K" or "8192K" into bytes.
+*/
+static long parseCacheSize(const char *text)
+{
+	char *end;
+	long size = strtol(text, &end, 10);
+	if(*end == 'K')
+	{
+		size *= 1024;
+	}
+	else if(*end == 'M')
+	{
+		size *= 1024 * 1024;
+	}
+	return size;
+}
+
+/**
+   Read a single line sysfs attribute of cache index into buf.
+*/
+static _Bool readCacheAttr(int index, const char *attr, char *buf, int bufSize)
+{
+	char path[128];
+	snprintf(path, sizeof(path), CACHE_SYSFS_DIR "/index%d/%s", index, attr);
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+	{
+		return false;
+	}
+	_Bool ok = (fgets(buf, bufSize, fp) != NULL);
+	fclose(fp);
+	return ok;
+}
+
+/**
+   Return the largest power of two tile such that nTiles tiles of ints
+   fill at most half of a cache of cacheBytes, within [MIN_TILE, MAX_TILE].
+*/
+static int fitTile(long cacheBytes, int nTiles, int fallback)
+{
+	if(cacheBytes <= 0)
+	{
+		return fallback;
+	}
+
+	int tile = MIN_TILE;
+	while(tile * 2 <= MAX_TILE &&
+	      (long) nTiles * (tile * 2) * (tile * 2) * (long) sizeof(int) <= cacheBytes / 2)
+	{
+		tile *= 2;
+	}
+	return tile;
+}
+
+/**
+   Walk the cache indices of cpu0 and record the data cache sizes per level.
+*/
+void readMatrixCacheSizes(MatrixTuning *tuning)
+{
+	tuning -> l1dBytes = tuning -> l2Bytes = tuning -> l3Bytes = 0;
+
+	char level[16], type[32], size[32];
+	for(int index = 0; readCacheAttr(index, "level", level, sizeof(level)); index++)
+	{
+		if(!readCacheAttr(index, "type", type, sizeof(type)) ||
+		   !readCacheAttr(index, "size", size, sizeof(size)))
+		{
+			continue;
+		}
+		if(strncmp(type, "Instruction", 11) == 0)
+		{
+			continue;					// only data caches matter
+		}
+
+		long bytes = parseCacheSize(size);
+		switch(atoi(level))
+		{
+			case 1: tuning -> l1dBytes = bytes; break;
+			case 2: tuning -> l2Bytes = bytes; break;
+			case 3: tuning -> l3Bytes = bytes; break;
+		}
+	}
+
+	/**
+	  A transpose block reads one tile and writes another, so two tiles
+	  should fit in L1; a multiply tile touches panels of a, bT and c,
+	  so three tiles should fit in L2.
+	*/
+	tuning -> transposeTile = fitTile(tuning -> l1dBytes, 2, 32);
+	tuning -> mulTile = fitTile(tuning -> l2Bytes, 3, 64);
+}
+
+/**
+   Parse "key value" lines; blank lines and lines starting with # are ignored.
+*/
+void loadMatrixTuning(MatrixTuning *tuning, const char *path, int *err)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+	{
+		*err = errno;					// set error code
+		return;
+	}
+
+	char line[128], key[64];
+	long value;
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if(line[0] == '#' || sscanf(line, "%63s %ld", key, &value) != 2)
+		{
+			continue;
+		}
+		if(strcmp(key, "l1d") == 0)
+		{
+			tuning -> l1dBytes = value;
+		}
+		else if(strcmp(key, "l2") == 0)
+		{
+			tuning -> l2Bytes = value;
+		}
+		else if(strcmp(key, "l3") == 0)
+		{
+			tuning -> l3Bytes = value;
+		}
+		else if(strcmp(key, "mulTile") == 0 && value >= 1)
+		{
+			tuning -> mulTile = (int) value;
+		}
+		else if(strcmp(key, "transposeTile") == 0 && value >= 1)
+		{
+			tuning -> transposeTile = (int) value;
+		}
+	}
+	fclose(fp);
+}
+
+/**
+   Write the tuning as "key value" lines readable by loadMatrixTuning().
+*/
+void saveMatrixTuning(const MatrixTuning *tuning, const char *path, int *err)
+{
+	FILE *fp = fopen(path, "w");
+	if(fp == NULL)
+	{
+		*err = errno;					// set error code
+		return;
+	}
+
+	fprintf(fp, "# matrix kernel blocking, written by matrix_tuner\n");
+	fprintf(fp, "l1d %ld\n", tuning -> l1dBytes);
+	fprintf(fp, "l2 %ld\n", tuning -> l2Bytes);
+	fprintf(fp, "l3 %ld\n", tuning -> l3Bytes);
+	fprintf(fp, "mulTile %d\n", tuning -> mulTile);
+	fprintf(fp, "transposeTile %d\n", tuning -> transposeTile);
+
+	if(fclose(fp) != 0)
+	{
+		*err = errno;					// set error code
+	}
+}
+
+/**
+   Return the loaded tuning, loading it on first use.
+*/
+const MatrixTuning *getMatrixTuning(void)
+{
+	if(!isLoaded)
+	{
+		readMatrixCacheSizes(&tuning);			// defaults from this host
+
+		const char *path = getenv("MATRIX_TUNE_FILE");
+		int err = 0;
+		loadMatrixTuning(&tuning, (path != NULL) ? path : MATRIX_TUNE_FILE, &err);	// missing file keeps defaults
+		isLoaded = true;
+	}
+	return &tuning;
+}
+
+/**
+   Return monotonic time in seconds.
+*/
+static double nowSeconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+   Return the best of TUNE_REPEATS timings of a transpose with tile.
+*/
+static double timeTranspose(const int *src, int *dst, int tile)
+{
+	double best = 0;
+	for(int repeat = 0; repeat < TUNE_REPEATS; repeat++)
+	{
+		double start = nowSeconds();
+		transposeKernel(src, TUNE_TRANSPOSE_N, TUNE_TRANSPOSE_N, dst, tile);
+		double elapsed = nowSeconds() - start;
+		if(repeat == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+	return best;
+}
+
+/**
+   Return the best of TUNE_REPEATS timings of a multiply with tile.
+*/
+static double timeMul(const int *a, const int *bT, int *c, int tile)
+{
+	double best = 0;
+	for(int repeat = 0; repeat < TUNE_REPEATS; repeat++)
+	{
+		double start = nowSeconds();
+		mulTransposedKernel(a, bT, TUNE_MUL_N, TUNE_MUL_N, TUNE_MUL_N, c, 0, TUNE_MUL_N, tile);
+		double elapsed = nowSeconds() - start;
+		if(repeat == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+	return best;
+}
+
+/**
+   Try every power of two tile in [MIN_TILE, MAX_TILE] for both kernels
+   and keep the fastest.  Candidates are timed on problems much larger
+   than L2 so the measurement reflects blocking and not a warm cache.
+*/
+void tuneMatrixKernels(MatrixTuning *tuning, FILE *verbose, int *err)
+{
+	long transposeN = (long) TUNE_TRANSPOSE_N * TUNE_TRANSPOSE_N;
+	long mulN = (long) TUNE_MUL_N * TUNE_MUL_N;
+	int *src = malloc(transposeN * sizeof(int));
+	int *dst = malloc(transposeN * sizeof(int));
+	if(src == NULL || dst == NULL)
+	{
+		*err = ENOMEM;					// set error code
+		free(src);
+		free(dst);
+		return;
+	}
+
+	for(long i = 0; i < transposeN; i++)
+	{
+		src[i] = (int) i;
+		dst[i] = 0;
+	}
+
+	double bestTime = 0;
+	for(int tile = MIN_TILE; tile <= MAX_TILE; tile *= 2)
+	{
+		double elapsed = timeTranspose(src, dst, tile);
+		if(verbose != NULL)
+		{
+			fprintf(verbose, "transpose %dx%d tile %3d: %.3f ms\n",
+				TUNE_TRANSPOSE_N, TUNE_TRANSPOSE_N, tile, elapsed * 1e3);
+		}
+		if(tile == MIN_TILE || elapsed < bestTime)
+		{
+			bestTime = elapsed;
+			tuning -> transposeTile = tile;
+		}
+	}
+
+	/**
+	  The transpose buffers are large enough to hold a, bT and c of the
+	  multiply benchmark.
+	*/
+	const int *a = src;
+	const int *bT = src + mulN;
+	int *c = dst;
+	for(int tile = MIN_TILE; tile <= MAX_TILE; tile *= 2)
+	{
+		double elapsed = timeMul(a, bT, c, tile);
+		if(verbose != NULL)
+		{
+			fprintf(verbose, "mul %dx%d tile %3d: %.3f ms\n",
+				TUNE_MUL_N, TUNE_MUL_N, tile, elapsed * 1e3);
+		}
+		if(tile == MIN_TILE || elapsed < bestTime)
+		{
+			bestTime = elapsed;
+			tuning -> mulTile = tile;
+		}
+	}
+
+	free(src);
+	free(dst);
+}
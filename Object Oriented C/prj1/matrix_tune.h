@@ -0,0 +1,52 @@
+#ifndef _MATRIX_TUNE_H
+#define _MATRIX_TUNE_H
+
+#include <stdio.h>
+
+/** Default location of the per-host tuning file; overridden by the
+ *  MATRIX_TUNE_FILE environment variable.  It lives on local disk so
+ *  that hosts sharing a home directory keep their own parameters.
+ */
+#define MATRIX_TUNE_FILE "/var/tmp/matrix_tune.conf"
+
+/** Blocking parameters used by the matrix kernels together with the
+ *  cache sizes they were derived from.
+ */
+typedef struct MatrixTuning {
+  long l1dBytes;        //L1 data cache size, 0 if unknown
+  long l2Bytes;         //unified L2 cache size, 0 if unknown
+  long l3Bytes;         //unified L3 cache size, 0 if unknown
+  int mulTile;          //tile size for mulTransposedKernel()
+  int transposeTile;    //tile size for transposeKernel()
+} MatrixTuning;
+
+/** Return the tuning in effect for this process.  On first call it is
+ *  loaded from the tuning file; if there is no such file the tile sizes
+ *  are derived from the cache sizes reported in sysfs.
+ */
+const MatrixTuning *getMatrixTuning(void);
+
+/** Fill the cache sizes of *tuning from
+ *  /sys/devices/system/cpu/cpu0/cache and set the tile sizes to
+ *  defaults which fit those caches.
+ */
+void readMatrixCacheSizes(MatrixTuning *tuning);
+
+/** Micro-benchmark candidate tile sizes for the multiply and transpose
+ *  kernels and store the fastest in *tuning, which must already hold
+ *  the cache sizes.  If verbose is not NULL, progress is reported to
+ *  it.  Set *err to ENOMEM if the benchmark matrices cannot be
+ *  allocated.
+ */
+void tuneMatrixKernels(MatrixTuning *tuning, FILE *verbose, int *err);
+
+/** Write *tuning to path.  Set *err to errno on failure. */
+void saveMatrixTuning(const MatrixTuning *tuning, const char *path, int *err);
+
+/** Read path into *tuning, keeping the existing value of any parameter
+ *  not present in the file.  Set *err to errno if the file cannot be
+ *  opened.
+ */
+void loadMatrixTuning(MatrixTuning *tuning, const char *path, int *err);
+
+#endif //ifndef _MATRIX_TUNE_H
@@ -0,0 +1,58 @@
+/**
+ * Auto-tuner for the blocked matrix kernels.  It reads the cache
+ * sizes of this host, times candidate tile sizes for the multiply and
+ * transpose kernels and saves the fastest to the tuning file which
+ * getMatrixTuning() loads at startup.
+ *
+ * usage: matrix_tuner [<tune-file>]
+ */
+
+#include "matrix_tune.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, const char *argv[])
+{
+	if(argc > 2)
+	{
+		fprintf(stderr, "usage: %s [<tune-file>]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	const char *path = getenv("MATRIX_TUNE_FILE");
+	if(argc == 2)
+	{
+		path = argv[1];
+	}
+	else if(path == NULL)
+	{
+		path = MATRIX_TUNE_FILE;
+	}
+
+	int err = 0;
+	MatrixTuning tuning;
+	readMatrixCacheSizes(&tuning);
+	printf("L1d %ld bytes, L2 %ld bytes, L3 %ld bytes\n",
+	       tuning.l1dBytes, tuning.l2Bytes, tuning.l3Bytes);
+
+	tuneMatrixKernels(&tuning, stdout, &err);
+	if(err != 0)
+	{
+		fprintf(stderr, "%s: tuning failed: %s\n", argv[0], strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+	saveMatrixTuning(&tuning, path, &err);
+	if(err != 0)
+	{
+		fprintf(stderr, "%s: cannot write %s: %s\n", argv[0], path, strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+	printf("mulTile %d, transposeTile %d written to %s\n",
+	       tuning.mulTile, tuning.transposeTile, path);
+	return 0;
+}
@@ -0,0 +1,261 @@
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/** Description of how to open one PerfEvent. */
+typedef struct {
+	const char *name;			// short name
+	uint32_t type;				// perf_event_attr.type
+	uint64_t config;			// perf_event_attr.config
+} PerfEventSpec;
+
+/**
+ * Encoding of a hardware cache read miss event
+ */
+#define CACHE_READ_MISS(cache) \
+	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const PerfEventSpec eventSpecs[N_PERF_EVENTS] = {
+	[PERF_CYCLES]       = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	[PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	[PERF_L1D_MISSES]   = { "l1d-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+	[PERF_LLC_MISSES]   = { "llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	[PERF_DTLB_MISSES]  = { "dtlb-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+/** Layout of a counter read with TOTAL_TIME_ENABLED|TOTAL_TIME_RUNNING. */
+typedef struct {
+	uint64_t value;				// raw count
+	uint64_t timeEnabled;			// ns the event was enabled
+	uint64_t timeRunning;			// ns the event was on a PMU
+} PerfReading;
+
+/** Layout of a group read with GROUP|TOTAL_TIME_ENABLED|TOTAL_TIME_RUNNING. */
+typedef struct {
+	uint64_t nr;				// events in the group
+	uint64_t timeEnabled;			// ns the group was enabled
+	uint64_t timeRunning;			// ns the group was on a PMU
+	uint64_t values[N_PERF_EVENTS];		// counts, leader first, in opening order
+} PerfGroupReading;
+
+/**
+   Open one counter, as a member of the group led by groupFd if that is
+   not -1; return its fd or -1.
+*/
+static int openEvent(const PerfEventSpec *spec, pid_t pid, int groupFd, bool grouped)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = spec -> type;
+	attr.config = spec -> config;
+	attr.disabled = (groupFd == -1);			// members follow their leader
+	attr.inherit = 1;					// count threads and children
+	attr.exclude_kernel = 1;				// allowed with perf_event_paranoid 2
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	if(grouped)
+	{
+		attr.read_format |= PERF_FORMAT_GROUP;
+	}
+
+	return (int) syscall(SYS_perf_event_open, &attr, pid, -1, groupFd, 0);
+}
+
+/**
+   Open the events as one group led by cycles, so that they are
+   scheduled onto the PMU together and their ratios come from the same
+   time window even when the kernel multiplexes.  An event which cannot
+   join the group (or every event, if the leader cannot be opened) is
+   opened on its own instead.
+*/
+void openPerfCounters(PerfCounters *counters, pid_t pid)
+{
+	int leader = openEvent(&eventSpecs[PERF_CYCLES], pid, -1, true);
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		int fd = -1;
+		if(leader >= 0)
+		{
+			fd = (event == PERF_CYCLES) ? leader : openEvent(&eventSpecs[event], pid, leader, true);
+		}
+		counters -> inGroup[event] = (fd >= 0);
+		if(fd < 0)
+		{
+			fd = openEvent(&eventSpecs[event], pid, -1, false);
+		}
+		counters -> fds[event] = fd;
+	}
+}
+
+void closePerfCounters(PerfCounters *counters)
+{
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		if(counters -> fds[event] >= 0)
+		{
+			close(counters -> fds[event]);
+			counters -> fds[event] = -1;
+		}
+	}
+}
+
+bool hasPerfCounters(const PerfCounters *counters)
+{
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		if(counters -> fds[event] >= 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+   Apply the ioctl request to the group as a whole and to every counter
+   outside it.
+*/
+static void controlCounters(PerfCounters *counters, unsigned long request)
+{
+	if(counters -> inGroup[PERF_CYCLES])
+	{
+		ioctl(counters -> fds[PERF_CYCLES], request, PERF_IOC_FLAG_GROUP);
+	}
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		if(counters -> fds[event] >= 0 && !counters -> inGroup[event])
+		{
+			ioctl(counters -> fds[event], request, 0);
+		}
+	}
+}
+
+void startPerfCounters(PerfCounters *counters)
+{
+	controlCounters(counters, PERF_EVENT_IOC_RESET);
+	controlCounters(counters, PERF_EVENT_IOC_ENABLE);
+}
+
+/**
+   Disable and read every counter, the group in a single read.  A
+   counter which never ran (too many events for the PMU) is reported
+   invalid rather than as zero.
+*/
+void stopPerfCounters(PerfCounters *counters, PerfSample *sample)
+{
+	controlCounters(counters, PERF_EVENT_IOC_DISABLE);
+
+	PerfGroupReading group;
+	bool haveGroup = counters -> inGroup[PERF_CYCLES] &&
+		read(counters -> fds[PERF_CYCLES], &group, sizeof(group)) >= (ssize_t) (3 * sizeof(uint64_t)) &&
+		group.timeRunning > 0;
+	int member = 0;
+
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		PerfReading reading;
+		sample -> values[event] = 0;
+		sample -> valid[event] = false;
+
+		if(counters -> inGroup[event])
+		{
+			int index = member++;
+			if(haveGroup && (uint64_t) index < group.nr)
+			{
+				double scale = (double) group.timeEnabled / group.timeRunning;
+				sample -> values[event] = (long long) (group.values[index] * scale);
+				sample -> valid[event] = true;
+			}
+			continue;
+		}
+
+		if(counters -> fds[event] < 0 ||
+		   read(counters -> fds[event], &reading, sizeof(reading)) != sizeof(reading) ||
+		   reading.timeRunning == 0)
+		{
+			continue;
+		}
+
+		double scale = (double) reading.timeEnabled / reading.timeRunning;
+		sample -> values[event] = (long long) (reading.value * scale);
+		sample -> valid[event] = true;
+	}
+}
+
+void addPerfSample(PerfSample *to, const PerfSample *from)
+{
+	for(int event = 0; event < N_PERF_EVENTS; event++)
+	{
+		if(from -> valid[event])
+		{
+			to -> values[event] = (to -> valid[event] ? to -> values[event] : 0) + from -> values[event];
+			to -> valid[event] = true;
+		}
+	}
+}
+
+const char *perfEventName(PerfEvent event)
+{
+	return (event >= 0 && event < N_PERF_EVENTS) ? eventSpecs[event].name : "unknown";
+}
+
+void formatPerfSample(const PerfSample *sample, double nOps, char *buf, size_t size)
+{
+	size_t used = 0;
+	buf[0] = '\0';
+
+	for(int event = 0; event < N_PERF_EVENTS && used < size; event++)
+	{
+		if(sample -> valid[event])
+		{
+			used += snprintf(buf + used, size - used, "%s%s=%.0f", (event > 0) ? " " : "",
+					 eventSpecs[event].name, sample -> values[event] / nOps);
+		}
+		else
+		{
+			used += snprintf(buf + used, size - used, "%s%s=n/a", (event > 0) ? " " : "",
+					 eventSpecs[event].name);
+		}
+	}
+
+	if(used < size && sample -> valid[PERF_CYCLES] && sample -> valid[PERF_INSTRUCTIONS] &&
+	   sample -> values[PERF_CYCLES] > 0)
+	{
+		snprintf(buf + used, size - used, " ipc=%.2f",
+			 (double) sample -> values[PERF_INSTRUCTIONS] / sample -> values[PERF_CYCLES]);
+	}
+}
+
+double perfNowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compareTimes(const void *p1, const void *p2)
+{
+	double d1 = *(const double *) p1, d2 = *(const double *) p2;
+	return (d1 > d2) - (d1 < d2);
+}
+
+void sortPerfTimes(double samples[], int n)
+{
+	qsort(samples, n, sizeof(double), compareTimes);
+}
+
+double perfTimeQuantile(const double sorted[], int n, double q)
+{
+	int rank = (int) (q * n + 0.999999);
+	rank = (rank < 1) ? 1 : (rank > n) ? n : rank;
+	return sorted[rank - 1];
+}
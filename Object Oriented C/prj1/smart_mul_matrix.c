@@ -1,6 +1,10 @@
 #include "abstract_matrix.h"			// getting implicit declaration warning so added
 #include "dense_matrix.h"
 #include "smart_mul_matrix.h"
+#include "matrix_alloc.h"
+#include "matrix_kernels.h"
+#include "matrix_ops.h"
+#include "matrix_tune.h"
 
 #include <errno.h>
 #include <stdbool.h>
@@ -132,6 +136,72 @@ static void setElement(Matrix *this, int rowIndex, int colIndex, MatrixBaseType
 	}
 }
 
+static SmartMulMatrixFns smartMulMatrixFns;	// virtual table, defined below
+
+/**
+   Return true if m is a smart mul matrix and its elements can be accessed directly.
+*/
+static _Bool isSmartMul(const Matrix *m)
+{
+	return m -> fns == (const MatrixFns *) &smartMulMatrixFns;
+}
+
+/** The function is used to transpose the given matrix.
+    When both matrices are smart mul matrices the elements are transposed
+    directly with the blocked kernel; otherwise the transpose inherited
+    from the dense matrix is used.
+*/
+static void transpose(const Matrix *this, Matrix *result, int *err)
+{
+	if(!isSmartMul(this) || !isSmartMul(result))
+	{
+		getDenseMatrixFns() -> transpose(this, result, err);			// inherited transpose
+		return;
+	}
+
+	const SmartMulMatrixImpl *smartMulMatrixImpl = (const SmartMulMatrixImpl *) this;	// cast to specific
+	SmartMulMatrixImpl *resultImpl = (SmartMulMatrixImpl *) result;				// cast to specific
+
+	if(smartMulMatrixImpl -> nRows != resultImpl -> nCols || smartMulMatrixImpl -> nCols != resultImpl -> nRows)
+	{
+		*err = EDOM;										// not compatible dimensions
+	}
+	else
+	{
+		transposeKernel(smartMulMatrixImpl -> element, smartMulMatrixImpl -> nRows, smartMulMatrixImpl -> nCols,
+				resultImpl -> element, getMatrixTuning() -> transposeTile);
+	}
+}
+
+/** The function multiplies two smart mul matrices directly on their elements.
+    The multiplier is transposed into a heap buffer with the blocked transpose
+    and the product is computed tile by tile, with tile sizes tuned for the
+    caches of this host (see matrix_tuner).
+*/
+static void mulDirect(const SmartMulMatrixImpl *first, const SmartMulMatrixImpl *second,
+		      SmartMulMatrixImpl *product, int *err)
+{
+	if(first -> nCols != second -> nRows || product -> nRows != first -> nRows || product -> nCols != second -> nCols)
+	{
+		*err = EDOM;									// set error code for invalid matrix
+		return;
+	}
+
+	int *multiplierTranspose = malloc((size_t) second -> nRows * second -> nCols * sizeof(int));
+	if(multiplierTranspose == NULL)
+	{
+		*err = ENOMEM;									// set error code
+		return;
+	}
+
+	const MatrixTuning *tuning = getMatrixTuning();
+	transposeKernel(second -> element, second -> nRows, second -> nCols, multiplierTranspose, tuning -> transposeTile);
+	mulTransposedKernel(first -> element, multiplierTranspose, first -> nRows, first -> nCols, second -> nCols,
+			    product -> element, 0, first -> nRows, tuning -> mulTile);
+
+	free(multiplierTranspose);
+}
+
 /** The function is used to multiply two given matrices.
     The multiplication of two matrix is accessing elements row-wise from the first matrix
     and then getting column-wise elements from the second matrix to get each element
@@ -144,6 +214,13 @@ static void setElement(Matrix *this, int rowIndex, int colIndex, MatrixBaseType
 */
 static void mul(const Matrix *this, const Matrix *multiplier, Matrix *product, int *err)
 {
+	if(isSmartMul(this) && isSmartMul(multiplier) && isSmartMul(product))
+	{
+		mulDirect((const SmartMulMatrixImpl *) this, (const SmartMulMatrixImpl *) multiplier,
+			  (SmartMulMatrixImpl *) product, err);					// blocked kernel
+		return;
+	}
+
 	int first_nRows = this -> fns -> getNRows(this, err);          // get rows in first matrix
 	int first_nCols = this -> fns -> getNCols(this, err);	       // get cols in first matrix	
 
@@ -218,6 +295,18 @@ static void mul(const Matrix *this, const Matrix *multiplier, Matrix *product, i
 }
 
 
+/**
+   This function returns the row-major array holding the smart mul matrix entries,
+   which lets the element-wise operations of matrix_ops.h run directly on it.
+*/
+static MatrixBaseType *elements(const Matrix *this)
+{
+	const SmartMulMatrixImpl *smartMulMatrixImpl = (const SmartMulMatrixImpl *) this;	// cast to specific
+	return (MatrixBaseType *) smartMulMatrixImpl -> element;				// contiguous entries
+}
+
+static MatrixOpsFns smartMulMatrixOpsFns;			// element-wise operations, inherited in constructor
+
 /** Initializing Function Pointers to design OOP concept in C language. 
     This is equivalent to virtual table in C++.
     The basic abstract interfaces to be able to use by sub-classes and its sub-classes 
@@ -230,6 +319,7 @@ static SmartMulMatrixFns smartMulMatrixFns = {
         .getNCols = getNCols,			// implemented above - override
         .getElement = getElement,		// implemented above - override
         .setElement = setElement,		// implemented above - override
+        .transpose = transpose,			// implemented above - override
         .mul = mul				// implemented above - override
 
 };
@@ -260,7 +350,7 @@ SmartMulMatrix *newSmartMulMatrix(int nRows, int nCols, int *err)
            	  This memory allocation stores structure elements in a consecutive memory location.
            	  All elements are being stored contiguously.
         	*/
-        	smartMulMatrix = (SmartMulMatrixImpl *) malloc(sizeof(SmartMulMatrixImpl) + nRows * nCols * sizeof(int));       // dynamic memory allocation
+        	smartMulMatrix = (SmartMulMatrixImpl *) allocMatrixStorage(sizeof(SmartMulMatrixImpl) + (size_t) nRows * nCols * sizeof(int), err);       // huge page backed when large
 
         	if(!smartMulMatrix)                // check for enough memory allocation
         	{
@@ -272,8 +362,10 @@ SmartMulMatrix *newSmartMulMatrix(int nRows, int nCols, int *err)
         		if(!isInit)                                                             // check init bool variable     
         		{
 				const DenseMatrixFns *fns = getDenseMatrixFns();		// get super class
-                		smartMulMatrixFns.transpose = fns -> transpose;                 // inherit super method transpose       
                 		smartMulMatrixFns.free = fns -> free;                           // inherit super method free
+                		smartMulMatrixOpsFns = *getAbstractMatrixOpsFns();              // inherit element-wise operations
+                		smartMulMatrixOpsFns.elements = elements;                       // override - contiguous storage
+                		registerMatrixOpsFns((const MatrixFns *) &smartMulMatrixFns, &smartMulMatrixOpsFns);
                			isInit = true;                                                  // one instance to exit for entire program
         		}
 
@@ -282,10 +374,7 @@ SmartMulMatrix *newSmartMulMatrix(int nRows, int nCols, int *err)
 	        	smartMulMatrix -> nRows = nRows;                                        // allocate memory for rows
         		smartMulMatrix -> nCols = nCols;                                        // allocate memory for cols
 
-	        	for(int counter = 0; counter < nRows * nCols; counter++)
-        		{
-                		smartMulMatrix -> element[counter] = counter;                   // initialize to offset values
-        		}
+	        	touchMatrixElements(smartMulMatrix -> element, (long) nRows * nCols);      // initialize to offset values
 		}
 	}
 